@@ -255,6 +255,10 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_MAPASYNC		0x100000
 	/** tie reader locktable slots to #MDB_txn objects instead of to threads */
 #define MDB_NOTLS		0x200000
+	/** sync and publish each commit while the next write txn is built */
+#define MDB_PIPELINE	0x400000
+	/** clear stale reader table slots automatically */
+#define MDB_READERCHECK	0x800000
 /** @} */
 
 /**	@defgroup	mdb_dbi_open	Database Flags
@@ -505,6 +509,23 @@ int  mdb_env_create(MDB_env **env);
 	 *		user threads over individual OS threads need this option. Such an
 	 *		application must also serialize the write transactions in an OS
 	 *		thread, since MDB's write locking is unaware of the user threads.
+	 *	<li>#MDB_PIPELINE
+	 *		Release the write lock as soon as a transaction's pages have been
+	 *		written, and flush them and write its meta page afterwards, while
+	 *		the next write transaction is already being built on top of it.
+	 *		#mdb_txn_commit() still returns only once the transaction is
+	 *		published, and read-only transactions only ever see published
+	 *		transactions. At most one transaction is in flight at a time.
+	 *		Only valid when a single process writes to the environment, since
+	 *		the unpublished state is kept in this #MDB_env. Not supported with
+	 *		#MDB_WRITEMAP or on Windows.
+	 *	<li>#MDB_READERCHECK
+	 *		Call #mdb_reader_check() automatically when #mdb_txn_begin() finds
+	 *		the reader table full, and when a write transaction can't reuse
+	 *		free pages because of a reader whose process no longer exists.
+	 *		Only safe if every process using the environment shares one PID
+	 *		namespace, see #mdb_reader_check(). This flag may be changed at
+	 *		any time using #mdb_env_set_flags().
 	 * </ul>
 	 * @param[in] mode The UNIX permissions to set on created files. This parameter
 	 * is ignored on Windows.
@@ -568,6 +589,42 @@ int  mdb_env_info(MDB_env *env, MDB_envinfo *stat);
 	 */
 int  mdb_env_sync(MDB_env *env, int force);
 
+	/** @brief Return the durable transaction ID watermark.
+	 *
+	 * This is the ID of the newest transaction known to be flushed to disk
+	 * by this environment handle: either by a synchronous #mdb_txn_commit()
+	 * or by a completed #mdb_env_sync(). Commits made by other processes are
+	 * only accounted for once this handle calls #mdb_env_sync().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] txnid Address where the transaction ID will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_durable(MDB_env *env, size_t *txnid);
+
+	/** @brief Wait for a transaction to become durable.
+	 *
+	 * Block until the watermark returned by #mdb_env_durable() reaches
+	 * \b txnid. This function does not flush anything itself; some other
+	 * thread must be committing synchronously or calling #mdb_env_sync().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] txnid The transaction ID to wait for
+	 * @param[in] timeout Maximum time to wait in milliseconds, or a negative
+	 * value to wait forever
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_PANIC - a fatal error occurred earlier and the environment
+	 *		must be shut down.
+	 *	<li>ETIMEDOUT - the timeout expired first.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_wait_durable(MDB_env *env, size_t txnid, int timeout);
+
 	/** @brief Close the environment and release the memory map.
 	 *
 	 * Only a single thread may call this function. All transactions, databases,
@@ -670,6 +727,29 @@ int  mdb_env_set_maxreaders(MDB_env *env, unsigned int readers);
 	 */
 int  mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers);
 
+	/** @brief Check for stale entries in the reader lock table.
+	 *
+	 * Clears the slots of read-only transactions whose process no longer
+	 * exists, e.g. because it crashed. Such slots count against
+	 * #mdb_env_set_maxreaders(), and keep the pages their transaction
+	 * used from being reused, so the database file keeps growing.
+	 * With #MDB_READERCHECK this is done automatically when needed.
+	 *
+	 * A process is considered gone if its PID can't be found, so every
+	 * process using the environment must share one PID namespace. If the
+	 * lock file is shared between e.g. containers with their own PID
+	 * namespaces, live readers in another namespace are cleared, and
+	 * writers then reuse pages those readers are still using.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] dead Number of stale slots that were cleared, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_reader_check(MDB_env *env, int *dead);
+
 	/** @brief Set the maximum number of named databases for the environment.
 	 *
 	 * This function is only needed if multiple databases will be used in the
@@ -686,6 +766,30 @@ int  mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers);
 	 */
 int  mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs);
 
+	/** @brief Flush the environment from a background thread.
+	 *
+	 * When either parameter is non-zero, #mdb_env_open() starts a thread
+	 * that calls #mdb_env_sync() with \b force set whenever \b interval
+	 * milliseconds have passed or \b bytes of pages have been committed
+	 * since its last flush, and #mdb_env_close() stops it after a final
+	 * flush. Combined with #MDB_NOSYNC this bounds how much a system crash
+	 * can lose, and #mdb_env_durable() reports what is safe. If a
+	 * background flush fails, the environment is marked as having a fatal
+	 * error, since transactions that were already committed may be lost.
+	 * This function may only be called after #mdb_env_create() and before
+	 * #mdb_env_open(). Read-only environments ignore it.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] interval Maximum time between flushes in milliseconds, or 0
+	 * @param[in] bytes Amount of committed data that triggers a flush, or 0
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, the environment is
+	 *	already open, or background flushing is unsupported (Windows).
+	 * </ul>
+	 */
+int  mdb_env_set_syncparams(MDB_env *env, unsigned int interval, size_t bytes);
+
 	/** @brief Create a transaction for use with the environment.
 	 *
 	 * The transaction handle may be discarded using #mdb_txn_abort() or #mdb_txn_commit().
@@ -715,12 +819,23 @@ int  mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs);
 	 *	<li>#MDB_MAP_RESIZED - another process wrote data beyond this MDB_env's
 	 *		mapsize and the environment must be shut down.
 	 *	<li>#MDB_READERS_FULL - a read-only transaction was requested and
-	 *		the reader lock table is full. See #mdb_env_set_maxreaders().
+	 *		the reader lock table is full. See #mdb_env_set_maxreaders()
+	 *		and #MDB_READERCHECK.
 	 *	<li>ENOMEM - out of memory.
 	 * </ul>
 	 */
 int  mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **txn);
 
+	/** @brief Return the transaction's ID.
+	 *
+	 * For a read-only transaction this is the ID of the snapshot it reads.
+	 * For a write transaction it is the ID the transaction will have once
+	 * committed, which may be passed to #mdb_env_wait_durable().
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @return The transaction ID, or 0 if \b txn is NULL.
+	 */
+size_t mdb_txn_id(MDB_txn *txn);
+
 	/** @brief Commit all the operations of a transaction into the database.
 	 *
 	 * The transaction handle is freed. It and its cursors must not be used
@@ -868,6 +983,15 @@ int  mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *d
 	 */
 int  mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 
+	/** @brief Retrieve the DB flags for a database handle.
+	 *
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[out] flags Address where the flags will be returned.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_dbi_flags(MDB_txn *txn, MDB_dbi dbi, unsigned int *flags);
+
 	/** @brief Close a database handle.
 	 *
 	 * This call is not mutex protected. Handles should only be closed by
@@ -1039,7 +1163,9 @@ int  mdb_get(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
 	 * errors are:
 	 * <ul>
 	 *	<li>#MDB_MAP_FULL - the database is full, see #mdb_env_set_mapsize().
-	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages.
+	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages. Top-level
+	 *		transactions write dirty pages out early to make room, so this
+	 *		normally only happens inside nested transactions.
 	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
 	 *	<li>EINVAL - an invalid parameter was specified.
 	 * </ul>
@@ -1139,7 +1265,9 @@ MDB_dbi mdb_cursor_dbi(MDB_cursor *cursor);
 	 * of the key are returned in the object to which \b key refers (except for the
 	 * case of the #MDB_SET option, in which the \b key object is unchanged), and
 	 * the address and length of the data are returned in the object to which \b data
-	 * refers.
+	 * refers. On databases without #MDB_DUPSORT, \b data may be NULL when moving
+	 * the cursor, in which case the item's data is not resolved; this avoids
+	 * locating the overflow pages of large items during key-only scans.
 	 * See #mdb_get() for restrictions on using the output values.
 	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
 	 * @param[in,out] key The key for a retrieved item
@@ -1194,7 +1322,9 @@ int  mdb_cursor_get(MDB_cursor *cursor, MDB_val *key, MDB_val *data,
 	 * errors are:
 	 * <ul>
 	 *	<li>#MDB_MAP_FULL - the database is full, see #mdb_env_set_mapsize().
-	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages.
+	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages. Top-level
+	 *		transactions write dirty pages out early to make room, so this
+	 *		normally only happens inside nested transactions.
 	 *	<li>EACCES - an attempt was made to modify a read-only database.
 	 *	<li>EINVAL - an invalid parameter was specified.
 	 * </ul>
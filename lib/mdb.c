@@ -41,6 +41,7 @@
 #else
 #include <sys/uio.h>
 #include <sys/mman.h>
+#include <signal.h>
 #ifdef HAVE_SYS_FILE_H
 #include <sys/file.h>
 #endif
@@ -157,6 +158,7 @@
 #define	MDB_FDATASYNC(fd)	(!FlushFileBuffers(fd))
 #define	MDB_MSYNC(addr,len,flags)	(!FlushViewOfFile(addr,len))
 #define	ErrCode()	GetLastError()
+#define MDB_FENCE()	MemoryBarrier()
 #define GET_PAGESIZE(x) {SYSTEM_INFO si; GetSystemInfo(&si); (x) = si.dwPageSize;}
 #define	close(fd)	CloseHandle(fd)
 #define	munmap(ptr,len)	UnmapViewOfFile(ptr)
@@ -195,6 +197,19 @@ mdb_sem_wait(sem_t *sem)
 #define UNLOCK_MUTEX_W(env)	pthread_mutex_unlock(&(env)->me_txns->mti_wmutex)
 #endif	/* MDB_USE_POSIX_SEM */
 
+#ifdef __GNUC__
+	/** Atomically replace \b old with \b new at \b ptr.
+	 *	Used to claim reader slots without taking the reader mutex.
+	 *	@return true if \b ptr held \b old.
+	 */
+#define MDB_CAS(ptr, old, new)	__sync_bool_compare_and_swap(ptr, old, new)
+	/** Full memory barrier: earlier stores are visible before later loads.
+	 */
+#define MDB_FENCE()	__sync_synchronize()
+#else
+#define MDB_FENCE()
+#endif
+
 	/** Get the error code for the last failed system function.
 	 */
 #define	ErrCode()	errno
@@ -345,6 +360,12 @@ static txnid_t mdb_debug_start;
 	/**	The version number for a database's file format. */
 #define MDB_VERSION	 1
 
+	/**	The version number for the lock file's format. Version 2 claims
+	 *	reader slots with #MDB_CAS instead of the reader mutex, so it must
+	 *	not share a lock file with processes using version 1.
+	 */
+#define MDB_LOCK_VERSION	 2
+
 	/**	@brief The maximum size of a key in the database.
 	 *
 	 *	We require that keys all fit onto a regular page. This limit
@@ -435,7 +456,9 @@ typedef uint16_t	 indx_t;
  *	while longer before being reclaimed. That's actually good anyway, because
  *	the longer we delay reclaiming old pages, the more likely it is that a
  *	string of contiguous pages can be found after coalescing old pages from
- *	many old transactions together.
+ *	many old transactions together. For the same reason the writer keeps
+ *	the result of its last scan and only scans again when that result
+ *	stops it from reusing pages, see #mdb_find_oldest().
  *	@{
  */
 	/**	Number of slots in the reader table.
@@ -458,9 +481,10 @@ typedef uint16_t	 indx_t;
 	 *	In addition to a transaction ID, we also record the process and
 	 *	thread ID that owns a slot, so that we can detect stale information,
 	 *	e.g. threads or processes that went away without cleaning up.
-	 *	@note We currently don't check for stale records. We simply re-init
-	 *	the table when we know that we're the only process opening the
-	 *	lock file.
+	 *	Slots of processes that no longer exist are cleared by
+	 *	#mdb_reader_check(). Threads that exit without cleaning up are not
+	 *	detected. We also re-init the table when we know that we're the
+	 *	only process opening the lock file.
 	 */
 typedef struct MDB_rxbody {
 	/**	Current Transaction ID when this transaction began, or (txnid_t)-1.
@@ -508,13 +532,14 @@ typedef struct MDB_txbody {
 		/** Stamp identifying this as an MDB file. It must be set
 		 *	to #MDB_MAGIC. */
 	uint32_t	mtb_magic;
-		/** Version number of this lock file. Must be set to #MDB_VERSION. */
+		/** Version number of this lock file. Must be set to #MDB_LOCK_VERSION. */
 	uint32_t	mtb_version;
 #if defined(_WIN32) || defined(MDB_USE_POSIX_SEM)
 	char	mtb_rmname[MNAME_LEN];
 #else
 		/** Mutex protecting access to this table.
-		 *	This is the reader lock that #LOCK_MUTEX_R acquires.
+		 *	This is the reader lock that #LOCK_MUTEX_R acquires. It is
+		 *	only used where #MDB_CAS isn't available.
 		 */
 	pthread_mutex_t	mtb_mutex;
 #endif
@@ -528,6 +553,10 @@ typedef struct MDB_txbody {
 		 *	when readers release their slots.
 		 */
 	unsigned	mtb_numreaders;
+		/** Where to start looking for a free slot in the reader table.
+		 *	Just a hint, updated without locking.
+		 */
+	unsigned	mtb_rhint;
 } MDB_txbody;
 
 	/** The actual reader table definition. */
@@ -540,6 +569,7 @@ typedef struct MDB_txninfo {
 #define mti_rmname	mt1.mtb.mtb_rmname
 #define mti_txnid	mt1.mtb.mtb_txnid
 #define mti_numreaders	mt1.mtb.mtb_numreaders
+#define mti_rhint	mt1.mtb.mtb_rhint
 		char pad[(sizeof(MDB_txbody)+CACHELINE-1) & ~(CACHELINE-1)];
 	} mt1;
 	union {
@@ -580,6 +610,7 @@ typedef struct MDB_page {
 #define	P_DIRTY		 0x10		/**< dirty page */
 #define	P_LEAF2		 0x20		/**< for #MDB_DUPFIXED records */
 #define	P_SUBP		 0x40		/**< for #MDB_DUPSORT sub-pages */
+#define	P_KEEP		 0x8000		/**< leave this page alone during spill */
 /** @} */
 	uint16_t	mp_flags;		/**< @ref mdb_page */
 #define mp_lower	mp_pb.pb.pb_lower
@@ -803,6 +834,26 @@ typedef struct MDB_dbx {
 	void		*md_relctx;		/**< user-provided context for md_rel */
 } MDB_dbx;
 
+	/** Number of slots in a dirty list's hash index. The index is never
+	 *	more than half full, so probe sequences stay short.
+	 */
+#define MDB_DHASH_SIZE	(MDB_IDL_UM_SIZE*2)
+	/** Bits of a hash slot holding a dirty list position */
+#define MDB_DHASH_IDXBITS	(MDB_IDL_LOGN+1)
+#define MDB_DHASH_IDXMASK	((1U<<MDB_DHASH_IDXBITS)-1)
+	/** Number of index generations before the slots must be cleared */
+#define MDB_DHASH_EPOCHS	(1U<<(32-MDB_DHASH_IDXBITS))
+
+	/** Hash index of a dirty list, mapping page numbers to positions.
+	 *	A slot holds a position in its low #MDB_DHASH_IDXBITS bits and the
+	 *	generation it was stored in above those. Slots of older generations
+	 *	are empty, so incrementing \b dh_epoch clears the whole index.
+	 */
+typedef struct MDB_dhash {
+	unsigned	dh_epoch;		/**< current generation, never 0 */
+	uint32_t	dh_slots[MDB_DHASH_SIZE];
+} MDB_dhash;
+
 	/** A database transaction.
 	 *	Every operation requires a transaction handle.
 	 */
@@ -819,10 +870,19 @@ struct MDB_txn {
 	/** The list of pages that became unused during this transaction.
 	 */
 	MDB_IDL		mt_free_pgs;
+	/** The sorted list of dirty pages we temporarily wrote to disk
+	 *	because the dirty list was full. Each entry is a pgno shifted
+	 *	left by one; the low bit marks pages that were dirtied again.
+	 *	Only used by top-level write txns, NULL if nothing was spilled.
+	 */
+	MDB_IDL		mt_spill_pgs;
 	union {
-		MDB_ID2L	dirty_list;	/**< for write txns: modified pages */
+		/** for write txns: modified pages, in no particular order */
+		MDB_ID2L	dirty_list;
 		MDB_reader	*reader;	/**< this thread's reader table slot or NULL */
 	} mt_u;
+	/** for write txns: index of the dirty list, see #mdb_dlist_find() */
+	MDB_dhash	*mt_dirty_hash;
 	/** Array of records for each DB known in the environment. */
 	MDB_dbx		*mt_dbxs;
 	/** Array of MDB_db records for each known DB */
@@ -852,6 +912,7 @@ struct MDB_txn {
 #define MDB_TXN_RDONLY		0x01		/**< read-only transaction */
 #define MDB_TXN_ERROR		0x02		/**< an error has occurred */
 #define MDB_TXN_DIRTY		0x04		/**< must write, even if dirty list is empty */
+#define MDB_TXN_SCANNED		0x08		/**< scanned the reader table, see #mdb_find_oldest() */
 /** @} */
 	unsigned int	mt_flags;		/**< @ref mdb_txn */
 	/** dirty_list maxsize - # of allocated pages allowed, including in parent txns */
@@ -942,6 +1003,8 @@ struct MDB_env {
 #define	MDB_ENV_ACTIVE	0x20000000U
 	/** me_txkey is set */
 #define	MDB_ENV_TXKEY	0x10000000U
+	/** me_sync_thr is running */
+#define	MDB_ENV_SYNCER	0x08000000U
 	uint32_t 	me_flags;		/**< @ref mdb_env */
 	unsigned int	me_psize;	/**< size of a page, from #GET_PAGESIZE */
 	unsigned int	me_maxreaders;	/**< size of the reader table */
@@ -969,10 +1032,30 @@ struct MDB_env {
 	MDB_IDL		me_free_pgs;
 	/** ID2L of pages written during a write txn. Length MDB_IDL_UM_SIZE. */
 	MDB_ID2L	me_dirty_list;
+	/** Hash index of #me_dirty_list */
+	MDB_dhash	*me_dirty_hash;
 	/** Max number of freelist items that can fit in a single overflow page */
 	unsigned int	me_maxfree_1pg;
 	/** Max size of a node on a page */
 	unsigned int	me_nodemax;
+	/** Oldest reader txnid seen by the last #mdb_find_oldest() scan */
+	txnid_t		me_oldest;
+	/** Newest txnid known to be on disk, see #mdb_env_durable() */
+	txnid_t		me_durable;
+	/** #MDB_PIPELINE: txn whose pages are written but whose meta is not */
+	txnid_t		me_pendtxnid;
+	pgno_t		me_pendlast;	/**< mm_last_pg of the pending txn */
+	MDB_db		me_penddbs[2];	/**< FREE_DBI and MAIN_DBI of the pending txn */
+	unsigned int	me_sync_interval;	/**< see #mdb_env_set_syncparams() */
+	size_t		me_sync_bytes;	/**< see #mdb_env_set_syncparams() */
+	size_t		me_unsynced;	/**< bytes committed since the last background sync */
+	int			me_sync_stop;	/**< tells the background sync thread to exit */
+#ifndef _WIN32
+	/** Protects the pending txn, #me_durable and background sync state */
+	pthread_mutex_t	me_pmutex;
+	pthread_cond_t	me_pcond;		/**< signalled when any of those change */
+	pthread_t	me_sync_thr;	/**< the background sync thread */
+#endif
 #ifdef _WIN32
 	HANDLE		me_rmutex;		/* Windows mutexes don't reside in shared mem */
 	HANDLE		me_wmutex;
@@ -1006,6 +1089,7 @@ static int  mdb_page_search_root(MDB_cursor *mc,
 #define MDB_PS_ROOTONLY	2
 static int  mdb_page_search(MDB_cursor *mc,
 			    MDB_val *key, int flags);
+static int  mdb_page_search_finger(MDB_cursor *mc, MDB_val *key);
 static int	mdb_page_merge(MDB_cursor *csrc, MDB_cursor *cdst);
 
 #define MDB_SPLIT_REPLACE	MDB_APPENDDUP	/**< newkey is not new */
@@ -1289,6 +1373,81 @@ mdb_page_free(MDB_env *env, MDB_page *mp)
 	env->me_dpages = mp;
 }
 
+/** Hash slot where the probe for a page number starts */
+#define DHASH(pgno)	((unsigned)(pgno) * 2654435761U & (MDB_DHASH_SIZE-1))
+
+/** Find a page in a transaction's own dirty list.
+ * @param[in] txn the transaction to search
+ * @param[in] pgno the page number to look for
+ * @return the page's position in the dirty list, or 0 if it's not there.
+ */
+static unsigned
+mdb_dlist_find(MDB_txn *txn, pgno_t pgno)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+	MDB_dhash *dh = txn->mt_dirty_hash;
+	uint32_t epoch = dh->dh_epoch << MDB_DHASH_IDXBITS, slot;
+	unsigned i, x;
+
+	for (i = DHASH(pgno);; i = (i+1) & (MDB_DHASH_SIZE-1)) {
+		slot = dh->dh_slots[i];
+		if ((slot & ~MDB_DHASH_IDXMASK) != epoch)
+			return 0;
+		x = slot & MDB_DHASH_IDXMASK;
+		if (dl[x].mid == pgno)
+			return x;
+	}
+}
+
+/** Add a dirty list entry to the list's hash index.
+ * @param[in] txn the transaction that owns the dirty list
+ * @param[in] x the position of the entry
+ */
+static void
+mdb_dlist_hash(MDB_txn *txn, unsigned x)
+{
+	MDB_dhash *dh = txn->mt_dirty_hash;
+	uint32_t epoch = dh->dh_epoch << MDB_DHASH_IDXBITS;
+	unsigned i;
+
+	for (i = DHASH(txn->mt_u.dirty_list[x].mid);
+		(dh->dh_slots[i] & ~MDB_DHASH_IDXMASK) == epoch;
+		i = (i+1) & (MDB_DHASH_SIZE-1))
+		;
+	dh->dh_slots[i] = epoch | x;
+}
+
+/** Append a page to a transaction's dirty list.
+ * @param[in] txn the transaction that owns the dirty list
+ * @param[in] id the page and its page number
+ */
+static void
+mdb_dlist_append(MDB_txn *txn, MDB_ID2 *id)
+{
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+
+	mdb_mid2l_append(dl, id);
+	mdb_dlist_hash(txn, dl[0].mid);
+}
+
+/** Rebuild the hash index of a transaction's dirty list.
+ * Must be called after entries were moved or removed.
+ * @param[in] txn the transaction that owns the dirty list
+ */
+static void
+mdb_dlist_reindex(MDB_txn *txn)
+{
+	MDB_dhash *dh = txn->mt_dirty_hash;
+	unsigned i;
+
+	if (++dh->dh_epoch == MDB_DHASH_EPOCHS) {
+		memset(dh->dh_slots, 0, sizeof(dh->dh_slots));
+		dh->dh_epoch = 1;
+	}
+	for (i = 1; i <= txn->mt_u.dirty_list[0].mid; i++)
+		mdb_dlist_hash(txn, i);
+}
+
 /* Return all dirty pages to dpage list */
 static void
 mdb_dlist_free(MDB_txn *txn)
@@ -1310,20 +1469,116 @@ mdb_dlist_free(MDB_txn *txn)
 	dl[0].mid = 0;
 }
 
-/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0. */
+/** Check whether a process still exists.
+ * Errs on the side of "yes", e.g. if we may not signal the process.
+ * @param[in] pid the process ID
+ * @return non-zero if the process may be alive.
+ */
+static int
+mdb_pid_alive(pid_t pid)
+{
+#ifdef _WIN32
+	HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, pid);
+	DWORD rc;
+
+	if (!h)
+		return ErrCode() != ERROR_INVALID_PARAMETER;
+	rc = WaitForSingleObject(h, 0);
+	CloseHandle(h);
+	return rc != WAIT_OBJECT_0;
+#else
+	return kill(pid, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+/** Clear the reader table slots of processes that no longer exist.
+ * Checkers are serialized by the reader mutex. A slot can only change
+ * hands while its mr_pid is 0, so resetting mr_txnid before clearing
+ * mr_pid never clobbers a live reader.
+ * @param[in] env the environment handle
+ * @param[out] dead number of slots cleared, or NULL
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_reader_check0(MDB_env *env, int *dead)
+{
+	MDB_txninfo *ti = env->me_txns;
+	MDB_reader *mr = ti->mti_readers;
+	unsigned i, n = ti->mti_numreaders;
+	int count = 0;
+	pid_t pid;
+
+	LOCK_MUTEX_R(env);
+	for (i=0; i<n; i++) {
+		pid = mr[i].mr_pid;
+		if (!pid || pid == env->me_pid || mdb_pid_alive(pid))
+			continue;
+		DPRINTF("clearing stale reader slot %u of pid %u", i, (unsigned)pid);
+		mr[i].mr_txnid = (txnid_t)-1;
+#ifdef MDB_CAS
+		/* Also a barrier, the slot mustn't look free before its txnid is reset */
+		MDB_CAS(&mr[i].mr_pid, pid, 0);
+#else
+		mr[i].mr_pid = 0;
+#endif
+		if (!count++)
+			ti->mti_rhint = i;
+	}
+	UNLOCK_MUTEX_R(env);
+	if (dead)
+		*dead = count;
+	return MDB_SUCCESS;
+}
+
+/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0.
+ * New readers always start at the last committed txnid, so the oldest
+ * txnid found by an earlier scan of the reader table remains a valid
+ * lower bound, only more conservative. The result is cached in the
+ * environment and the table is only scanned again if the cached value
+ * would keep pages freed by txn \b last from being reused, at most once
+ * per write txn. With #MDB_READERCHECK, if the reader holding those pages
+ * belongs to a process that no longer exists, stale slots are cleared and
+ * the table rescanned.
+ * @param[in] txn the write transaction looking for free pages
+ * @param[in] last the txn that freed the pages being considered
+ * @return a txnid; pages freed by txns older than this are unreferenced.
+ */
 static txnid_t
-mdb_find_oldest(MDB_txn *txn)
+mdb_find_oldest(MDB_txn *txn, txnid_t last)
 {
-	int i;
-	txnid_t mr, oldest = txn->mt_txnid - 1;
-	MDB_reader *r = txn->mt_env->me_txns->mti_readers;
-	for (i = txn->mt_env->me_txns->mti_numreaders; --i >= 0; ) {
+	int i, dead;
+	MDB_env *env = txn->mt_env;
+	txnid_t mr, oldest;
+	MDB_reader *r = env->me_txns->mti_readers;
+	pid_t pid;
+
+	if (env->me_oldest > last || (txn->mt_flags & MDB_TXN_SCANNED))
+		return env->me_oldest;
+	txn->mt_flags |= MDB_TXN_SCANNED;
+
+scan:
+	pid = 0;
+	oldest = txn->mt_txnid - 1;
+	/* With #MDB_PIPELINE our parent txn may not be published yet.
+	 * Keep its predecessor's pages too, like a normal commit does.
+	 */
+	mr = env->me_txns->mti_txnid;
+	if (oldest > mr)
+		oldest = mr;
+	for (i = env->me_txns->mti_numreaders; --i >= 0; ) {
 		if (r[i].mr_pid) {
 			mr = r[i].mr_txnid;
-			if (oldest > mr)
+			if (oldest > mr) {
 				oldest = mr;
+				pid = r[i].mr_pid;
+			}
 		}
 	}
+	if (oldest <= last && pid && (env->me_flags & MDB_READERCHECK) &&
+		pid != env->me_pid && !mdb_pid_alive(pid) &&
+		!mdb_reader_check0(env, &dead) && dead)
+		goto scan;
+	env->me_oldest = oldest;
 	return oldest;
 }
 
@@ -1344,7 +1599,7 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 	MDB_page *np;
 	pgno_t pgno = P_INVALID;
 	MDB_ID2 mid;
-	txnid_t oldest = 0, last;
+	txnid_t oldest, last;
 	int rc;
 
 	*mp = NULL;
@@ -1385,8 +1640,7 @@ again:
 				last = *(txnid_t *)key.mv_data;
 			}
 
-			if (!oldest)
-				oldest = mdb_find_oldest(txn);
+			oldest = mdb_find_oldest(txn, last);
 
 			if (oldest > last) {
 				/* It's usable, grab it.
@@ -1453,10 +1707,7 @@ none:
 
 						last = txn->mt_env->me_pglast + 1;
 
-						/* We haven't hit the readers list yet? */
-						if (!oldest) {
-							oldest = mdb_find_oldest(txn);
-						}
+						oldest = mdb_find_oldest(txn, last);
 
 						/* There's nothing we can use on the freelist */
 						if (oldest - last < 1)
@@ -1471,7 +1722,7 @@ none:
 							return rc;
 						}
 						last = *(txnid_t*)key.mv_data;
-						if (oldest <= last)
+						if ((oldest = mdb_find_oldest(txn, last)) <= last)
 							break;
 						idl = (MDB_ID *) data.mv_data;
 						mop2 = malloc(MDB_IDL_SIZEOF(idl) + MDB_IDL_SIZEOF(mop));
@@ -1553,11 +1804,7 @@ none:
 	}
 	mid.mid = np->mp_pgno;
 	mid.mptr = np;
-	if (txn->mt_env->me_flags & MDB_WRITEMAP) {
-		mdb_mid2l_append(txn->mt_u.dirty_list, &mid);
-	} else {
-		mdb_mid2l_insert(txn->mt_u.dirty_list, &mid);
-	}
+	mdb_dlist_append(txn, &mid);
 	txn->mt_dirty_room--;
 	*mp = np;
 
@@ -1586,6 +1833,54 @@ mdb_page_copy(MDB_page *dst, MDB_page *src, unsigned int psize)
 	}
 }
 
+/** Copy a spilled page back into the dirty list.
+ * @param[in] mc cursor pointing to the page to be touched
+ * @param[in] mp the page, as read from the map
+ * @param[out] ret the dirty copy, or NULL if \b mp was not spilled
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_unspill(MDB_cursor *mc, MDB_page *mp, MDB_page **ret)
+{
+	MDB_txn *txn = mc->mc_txn;
+	MDB_env *env = txn->mt_env;
+	MDB_IDL sl = txn->mt_spill_pgs;
+	MDB_ID pn = mp->mp_pgno << 1;
+	MDB_page *np;
+	MDB_ID2 mid;
+	unsigned x;
+
+	*ret = NULL;
+	x = mdb_midl_search(sl, pn);
+	if (x > sl[0] || sl[x] != pn)
+		return MDB_SUCCESS;
+	if (txn->mt_dirty_room == 0)
+		return MDB_TXN_FULL;
+
+	if (env->me_flags & MDB_WRITEMAP) {
+		np = mp;
+	} else {
+		if (!(np = mdb_page_malloc(mc, 1)))
+			return ENOMEM;
+		memcpy(np, mp, env->me_psize);
+	}
+	DPRINTF("unspilled db %u page %zu", mc->mc_dbi, mp->mp_pgno);
+	np->mp_flags |= P_DIRTY;
+
+	/* The page is dirty again, drop it from the spill list */
+	if (x == sl[0])
+		sl[0]--;
+	else
+		sl[x] |= 1;
+
+	mid.mid = np->mp_pgno;
+	mid.mptr = np;
+	mdb_dlist_append(txn, &mid);
+	txn->mt_dirty_room--;
+	*ret = np;
+	return MDB_SUCCESS;
+}
+
 /** Touch a page: make it dirty and re-insert into tree with updated pgno.
  * @param[in] mc cursor pointing to the page to be touched
  * @return 0 on success, non-zero on failure.
@@ -1599,6 +1894,15 @@ mdb_page_touch(MDB_cursor *mc)
 
 	if (!F_ISSET(mp->mp_flags, P_DIRTY)) {
 		MDB_page *np;
+		if (mc->mc_txn->mt_spill_pgs) {
+			if ((rc = mdb_page_unspill(mc, mp, &np)))
+				return rc;
+			if (np) {
+				/* Still has its pgno, so nothing to free */
+				mp = np;
+				goto finish;
+			}
+		}
 		if ((rc = mdb_page_alloc(mc, 1, &np)))
 			return rc;
 		DPRINTF("touched db %u page %zu -> %zu", mc->mc_dbi, mp->mp_pgno, np->mp_pgno);
@@ -1654,8 +1958,8 @@ finish:
 		 * dirty list.
 		 */
 		if (dl[0].mid) {
-			unsigned x = mdb_mid2l_search(dl, mp->mp_pgno);
-			if (x <= dl[0].mid && dl[x].mid == mp->mp_pgno) {
+			unsigned x = mdb_dlist_find(mc->mc_txn, mp->mp_pgno);
+			if (x) {
 				np = dl[x].mptr;
 				if (mp != np)
 					mc->mc_pg[mc->mc_top] = np;
@@ -1670,18 +1974,353 @@ finish:
 		memcpy(np, mp, mc->mc_txn->mt_env->me_psize);
 		mid.mid = np->mp_pgno;
 		mid.mptr = np;
-		mdb_mid2l_insert(dl, &mid);
+		mdb_dlist_append(mc->mc_txn, &mid);
 		mp = np;
 		goto finish;
 	}
 	return 0;
 }
 
+/** Mark a dirty page to be kept by the next #mdb_page_spill().
+ * @param[in] txn the transaction that owns the page
+ * @param[in] pgno the page to keep, if it's dirty
+ */
+static void
+mdb_page_keep(MDB_txn *txn, pgno_t pgno)
+{
+	MDB_page *mp;
+
+	if (mdb_page_get(txn, pgno, &mp, NULL) == MDB_SUCCESS &&
+		(mp->mp_flags & (P_DIRTY|P_SUBP)) == P_DIRTY)
+		mp->mp_flags |= P_KEEP;
+}
+
+/** Mark the dirty pages a cursor refers to with #P_KEEP.
+ * This covers the pages on its stack and, if the cursor is on a
+ * big data item, the overflow page holding it, so that pointers
+ * already handed out for the current record remain valid.
+ * @param[in] mc the cursor
+ */
+static void
+mdb_cursor_keep(MDB_cursor *mc)
+{
+	MDB_page *mp;
+	MDB_node *leaf;
+	pgno_t pgno;
+	unsigned i;
+
+	for (i=0; i<mc->mc_snum; i++) {
+		mp = mc->mc_pg[i];
+		if ((mp->mp_flags & (P_DIRTY|P_SUBP)) == P_DIRTY)
+			mp->mp_flags |= P_KEEP;
+	}
+	if (!(mc->mc_flags & C_INITIALIZED) || !mc->mc_snum)
+		return;
+	mp = mc->mc_pg[mc->mc_top];
+	if (!IS_LEAF(mp) || IS_LEAF2(mp) || mc->mc_ki[mc->mc_top] >= NUMKEYS(mp))
+		return;
+	leaf = NODEPTR(mp, mc->mc_ki[mc->mc_top]);
+	if (F_ISSET(leaf->mn_flags, F_BIGDATA)) {
+		memcpy(&pgno, NODEDATA(leaf), sizeof(pgno));
+		mdb_page_keep(mc->mc_txn, pgno);
+	} else if (F_ISSET(leaf->mn_flags, F_SUBDATA) && mc->mc_xcursor &&
+		(mc->mc_xcursor->mx_cursor.mc_flags & C_INITIALIZED)) {
+		mdb_cursor_keep(&mc->mc_xcursor->mx_cursor);
+	}
+}
+
+/** Write the dirty pages of a transaction to the data file.
+ * Pages marked #P_KEEP have the mark cleared and stay in the dirty
+ * list; all others are written and released.
+ * @param[in] txn the transaction whose pages to write
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_flush(MDB_txn *txn)
+{
+	MDB_env		*env = txn->mt_env;
+	MDB_ID2L	dl = txn->mt_u.dirty_list;
+	unsigned	i, j, pagecount = dl[0].mid;
+	MDB_page	*dp;
+	ssize_t		rc;
+	off_t		size;
+	int			n, done;
+	pgno_t		next;
+
+	if (env->me_flags & MDB_WRITEMAP) {
+		/* The pages are already in the map */
+		for (i=1, j=0; i<=pagecount; i++) {
+			dp = dl[i].mptr;
+			if (dp->mp_flags & P_KEEP) {
+				dp->mp_flags &= ~P_KEEP;
+				dl[++j] = dl[i];
+			} else {
+				/* clear dirty flag */
+				dp->mp_flags &= ~P_DIRTY;
+			}
+		}
+		goto done;
+	}
+
+	/* Write in pgno order, so adjacent pages can go out together */
+	mdb_mid2l_sort(dl);
+
+	/* Write up to MDB_COMMIT_PAGES dirty pages at a time until done.
+	 */
+	next = 0;
+	i = 1;
+	do {
+#ifdef _WIN32
+		/* Windows actually supports scatter/gather I/O, but only on
+		 * unbuffered file handles. Since we're relying on the OS page
+		 * cache for all our data, that's self-defeating. So we just
+		 * write pages one at a time. We use the ov structure to set
+		 * the write offset, to at least save the overhead of a Seek
+		 * system call.
+		 */
+		OVERLAPPED ov;
+		memset(&ov, 0, sizeof(ov));
+		for (; i<=pagecount; i++) {
+			size_t wsize;
+			dp = dl[i].mptr;
+			if (dp->mp_flags & P_KEEP)
+				continue;
+			DPRINTF("committing page %zu", dp->mp_pgno);
+			size = dp->mp_pgno * env->me_psize;
+			ov.Offset = size & 0xffffffff;
+			ov.OffsetHigh = size >> 16;
+			ov.OffsetHigh >>= 16;
+			/* clear dirty flag */
+			dp->mp_flags &= ~P_DIRTY;
+			wsize = env->me_psize;
+			if (IS_OVERFLOW(dp)) wsize *= dp->mp_pages;
+			rc = WriteFile(env->me_fd, dp, wsize, NULL, &ov);
+			if (!rc) {
+				n = ErrCode();
+				DPRINTF("WriteFile: %d", n);
+				return n;
+			}
+		}
+		done = 1;
+#else
+		struct iovec	 iov[MDB_COMMIT_PAGES];
+		n = 0;
+		done = 1;
+		size = 0;
+		for (; i<=pagecount; i++) {
+			dp = dl[i].mptr;
+			if (dp->mp_flags & P_KEEP)
+				continue;
+			if (dp->mp_pgno != next) {
+				if (n) {
+					rc = writev(env->me_fd, iov, n);
+					if (rc != size) {
+						n = ErrCode();
+						if (rc > 0)
+							DPUTS("short write, filesystem full?");
+						else
+							DPRINTF("writev: %s", strerror(n));
+						return n;
+					}
+					n = 0;
+					size = 0;
+				}
+				lseek(env->me_fd, dp->mp_pgno * env->me_psize, SEEK_SET);
+				next = dp->mp_pgno;
+			}
+			DPRINTF("committing page %zu", dp->mp_pgno);
+			iov[n].iov_len = env->me_psize;
+			if (IS_OVERFLOW(dp)) iov[n].iov_len *= dp->mp_pages;
+			iov[n].iov_base = (char *)dp;
+			size += iov[n].iov_len;
+			next = dp->mp_pgno + (IS_OVERFLOW(dp) ? dp->mp_pages : 1);
+			/* clear dirty flag */
+			dp->mp_flags &= ~P_DIRTY;
+			if (++n >= MDB_COMMIT_PAGES) {
+				done = 0;
+				i++;
+				break;
+			}
+		}
+
+		if (n == 0)
+			break;
+
+		rc = writev(env->me_fd, iov, n);
+		if (rc != size) {
+			n = ErrCode();
+			if (rc > 0)
+				DPUTS("short write, filesystem full?");
+			else
+				DPRINTF("writev: %s", strerror(n));
+			return n;
+		}
+#endif
+	} while (!done);
+
+	/* Release the pages we wrote */
+	for (i=1, j=0; i<=pagecount; i++) {
+		dp = dl[i].mptr;
+		if (dp->mp_flags & P_KEEP) {
+			dp->mp_flags &= ~P_KEEP;
+			dl[++j] = dl[i];
+		} else if (!IS_OVERFLOW(dp) || dp->mp_pages == 1) {
+			mdb_page_free(env, dp);
+		} else {
+			/* large pages just get freed directly */
+			VGMEMP_FREE(env, dp);
+			free(dp);
+		}
+	}
+
+done:
+	dl[0].mid = j;
+	mdb_dlist_reindex(txn);
+	txn->mt_dirty_room += pagecount - j;
+	return MDB_SUCCESS;
+}
+
+/** Spill pages from the dirty list back to disk.
+ * This keeps large write transactions from running into #MDB_TXN_FULL.
+ * Spilled pages are written to their final location in the data file
+ * and are read back through the map like any other clean page. If one
+ * is modified again, #mdb_page_touch() copies it back into the dirty
+ * list instead of allocating a new page for it.
+ *
+ * Pages the txn's cursors are using and the roots of its DBs are
+ * likely to be dirtied again soon, so they are kept. Of the rest, the
+ * pages at the front of the dirty list go first: pages are appended as
+ * they are dirtied, so those were dirtied earliest (the pages kept by
+ * a previous spill come first, in pgno order). Only
+ * a fraction of the dirty list is spilled at a time, since spilling
+ * everything just means copying most of it back again.
+ *
+ * Nested transactions never spill, so they and their parents can still
+ * get #MDB_TXN_FULL. So can an operation that needs more pages than
+ * estimated here.
+ * @param[in] m0 cursor for the current operation
+ * @param[in] key for a put operation, the key being stored, else NULL
+ * @param[in] data for a put operation, the data being stored
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
+{
+	MDB_txn *txn = m0->mc_txn;
+	MDB_env *env = txn->mt_env;
+	MDB_ID2L dl = txn->mt_u.dirty_list;
+	MDB_IDL sl;
+	MDB_cursor *mc;
+	MDB_page *dp;
+	unsigned i, j, need;
+	int rc = MDB_SUCCESS;
+
+	/* The freeDB is only written while committing, when the pages
+	 * it reserves must stay where they are.
+	 */
+	if ((m0->mc_flags & C_SUB) || m0->mc_dbi == FREE_DBI ||
+		txn->mt_parent || txn->mt_child)
+		return MDB_SUCCESS;
+
+	/* Estimate how much space this op will take */
+	need = m0->mc_db->md_depth;
+	/* Named DBs also dirty the main DB */
+	if (m0->mc_dbi > MAIN_DBI)
+		need += txn->mt_dbs[MAIN_DBI].md_depth;
+	/* For puts, roughly factor in the key+data size */
+	if (key)
+		need += (LEAFSIZE(key, data) + env->me_psize) / env->me_psize;
+	need += need;	/* double it for good measure */
+
+	if (txn->mt_dirty_room > need)
+		return MDB_SUCCESS;
+
+	if (!txn->mt_spill_pgs) {
+		if (!(txn->mt_spill_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)))
+			return ENOMEM;
+		txn->mt_spill_pgs[0] = 0;
+	} else {
+		/* Forget the pages that were dirtied again since the last spill */
+		sl = txn->mt_spill_pgs;
+		for (i=1, j=0; i<=sl[0]; i++) {
+			if (!(sl[i] & 1))
+				sl[++j] = sl[i];
+		}
+		sl[0] = j;
+	}
+
+	/* Preserve pages which may soon be dirtied again */
+	mdb_cursor_keep(m0);
+	for (i=0; i<txn->mt_numdbs; i++) {
+		for (mc = txn->mt_cursors[i]; mc; mc = mc->mc_next)
+			mdb_cursor_keep(mc);
+		if (txn->mt_dbs[i].md_root != P_INVALID)
+			mdb_page_keep(txn, txn->mt_dbs[i].md_root);
+	}
+
+	if (need < MDB_IDL_UM_MAX / 8)
+		need = MDB_IDL_UM_MAX / 8;
+	j = txn->mt_spill_pgs[0];
+
+	/* Pick the pages to spill, and keep the rest */
+	for (i=1; i<=dl[0].mid; i++) {
+		dp = dl[i].mptr;
+		if (dp->mp_flags & P_KEEP)
+			continue;
+		if (!need) {
+			dp->mp_flags |= P_KEEP;
+			continue;
+		}
+		if (mdb_midl_append(&txn->mt_spill_pgs, dp->mp_pgno << 1)) {
+			rc = ENOMEM;
+			goto fail;
+		}
+		need--;
+	}
+	mdb_midl_sort(txn->mt_spill_pgs);
+	DPRINTF("spilling %u dirty pages", (unsigned)txn->mt_spill_pgs[0] - j);
+
+	if ((rc = mdb_page_flush(txn)) != MDB_SUCCESS)
+		goto fail;
+	txn->mt_flags |= MDB_TXN_DIRTY;
+	return MDB_SUCCESS;
+
+fail:
+	for (i=1; i<=dl[0].mid; i++) {
+		dp = dl[i].mptr;
+		dp->mp_flags &= ~P_KEEP;
+	}
+	txn->mt_flags |= MDB_TXN_ERROR;
+	return rc;
+}
+
+/** Advance the durable txnid watermark and wake up any waiters.
+ * Waiters also recheck #MDB_FATAL_ERROR, so this is called with
+ * txnid 0 after a failed commit.
+ * @param[in] env the environment handle
+ * @param[in] txnid a transaction known to be on disk
+ */
+static void
+mdb_env_set_durable(MDB_env *env, txnid_t txnid)
+{
+#ifndef _WIN32
+	pthread_mutex_lock(&env->me_pmutex);
+#endif
+	if (env->me_durable < txnid)
+		env->me_durable = txnid;
+#ifndef _WIN32
+	pthread_cond_broadcast(&env->me_pcond);
+	pthread_mutex_unlock(&env->me_pmutex);
+#endif
+}
+
 int
 mdb_env_sync(MDB_env *env, int force)
 {
 	int rc = 0;
 	if (force || !F_ISSET(env->me_flags, MDB_NOSYNC)) {
+		/* Everything published before the flush is durable after it */
+		txnid_t txnid = env->me_txns ? env->me_txns->mti_txnid : 0;
 		if (env->me_flags & MDB_WRITEMAP) {
 			int flags = ((env->me_flags & MDB_MAPASYNC) && !force)
 				? MS_ASYNC : MS_SYNC;
@@ -1691,11 +2330,150 @@ mdb_env_sync(MDB_env *env, int force)
 			else if (flags == MS_SYNC && MDB_FDATASYNC(env->me_fd))
 				rc = ErrCode();
 #endif
+			if (flags != MS_SYNC)
+				txnid = 0;
 		} else {
 			if (MDB_FDATASYNC(env->me_fd))
 				rc = ErrCode();
 		}
+		if (!rc && txnid)
+			mdb_env_set_durable(env, txnid);
+	}
+	return rc;
+}
+
+#ifndef _WIN32
+/** Set a deadline for pthread_cond_timedwait().
+ * @param[out] ts the deadline
+ * @param[in] ms milliseconds from now
+ */
+static void
+mdb_deadline(struct timespec *ts, unsigned int ms)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (ms % 1000) * 1000000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/** Body of the background sync thread, see #mdb_env_set_syncparams().
+ * Sleeps on me_pcond until the interval passes or a commit pushes
+ * me_unsynced past the byte threshold, then flushes the environment.
+ * @param[in] arg the environment handle
+ */
+static void *
+mdb_env_syncer(void *arg)
+{
+	MDB_env *env = arg;
+	struct timespec ts;
+	int rc, due;
+
+	pthread_mutex_lock(&env->me_pmutex);
+	mdb_deadline(&ts, env->me_sync_interval);
+	while (!env->me_sync_stop) {
+		due = env->me_sync_bytes && env->me_unsynced >= env->me_sync_bytes;
+		if (!due) {
+			/* me_pcond is also broadcast for other reasons */
+			if (!env->me_sync_interval)
+				pthread_cond_wait(&env->me_pcond, &env->me_pmutex);
+			else if (pthread_cond_timedwait(&env->me_pcond, &env->me_pmutex,
+				&ts) == ETIMEDOUT)
+				due = 1;
+			if (!due)
+				continue;
+		}
+		mdb_deadline(&ts, env->me_sync_interval);
+		if (env->me_flags & MDB_FATAL_ERROR) {
+			/* Nothing more can become durable, wait for close */
+			env->me_unsynced = 0;
+			continue;
+		}
+		if (!env->me_unsynced)
+			continue;
+		env->me_unsynced = 0;
+		pthread_mutex_unlock(&env->me_pmutex);
+		rc = mdb_env_sync(env, 1);
+		pthread_mutex_lock(&env->me_pmutex);
+		if (rc) {
+			DPRINTF("background sync: %s", strerror(rc));
+			env->me_flags |= MDB_FATAL_ERROR;
+			pthread_cond_broadcast(&env->me_pcond);
+		}
+	}
+	pthread_mutex_unlock(&env->me_pmutex);
+	return NULL;
+}
+
+/** Count a commit towards the background sync thresholds.
+ * Must be called after the commit's meta page was written, so that the
+ * next background sync covers it.
+ * @param[in] env the environment handle
+ * @param[in] bytes the size of the pages the commit wrote
+ */
+static void
+mdb_env_syncer_add(MDB_env *env, size_t bytes)
+{
+	pthread_mutex_lock(&env->me_pmutex);
+	env->me_unsynced += bytes;
+	if (env->me_sync_bytes && env->me_unsynced >= env->me_sync_bytes)
+		pthread_cond_broadcast(&env->me_pcond);
+	pthread_mutex_unlock(&env->me_pmutex);
+}
+#endif
+
+int
+mdb_env_durable(MDB_env *env, size_t *txnid)
+{
+	if (!env || !txnid)
+		return EINVAL;
+	*txnid = env->me_durable;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_env_wait_durable(MDB_env *env, size_t txnid, int timeout)
+{
+	int rc = MDB_SUCCESS;
+#ifdef _WIN32
+	if (!env)
+		return EINVAL;
+	while (env->me_durable < txnid) {
+		if (env->me_flags & MDB_FATAL_ERROR)
+			return MDB_PANIC;
+		if (!timeout--)
+			return ETIMEDOUT;
+		Sleep(1);
+	}
+#else
+	struct timespec ts;
+
+	if (!env)
+		return EINVAL;
+	if (timeout > 0)
+		mdb_deadline(&ts, timeout);
+	pthread_mutex_lock(&env->me_pmutex);
+	while (env->me_durable < txnid) {
+		if (env->me_flags & MDB_FATAL_ERROR) {
+			rc = MDB_PANIC;
+			break;
+		}
+		if (!timeout) {
+			rc = ETIMEDOUT;
+			break;
+		}
+		if (timeout < 0) {
+			pthread_cond_wait(&env->me_pcond, &env->me_pmutex);
+		} else if (pthread_cond_timedwait(&env->me_pcond,
+			&env->me_pmutex, &ts) == ETIMEDOUT) {
+			rc = env->me_durable < txnid ? ETIMEDOUT : MDB_SUCCESS;
+			break;
+		}
 	}
+	pthread_mutex_unlock(&env->me_pmutex);
+#endif
 	return rc;
 }
 
@@ -1803,7 +2581,7 @@ mdb_txn_renew0(MDB_txn *txn)
 	MDB_env *env = txn->mt_env;
 	unsigned int i;
 	uint16_t x;
-	int rc, new_notls = 0;
+	int rc, new_notls = 0, pend = 0;
 
 	/* Setup db info */
 	txn->mt_numdbs = env->me_numdbs;
@@ -1814,6 +2592,9 @@ mdb_txn_renew0(MDB_txn *txn)
 			i = mdb_env_pick_meta(env);
 			txn->mt_txnid = env->me_metas[i]->mm_txnid;
 			txn->mt_u.reader = NULL;
+			txn->mt_toggle = txn->mt_txnid & 1;
+			txn->mt_next_pgno = env->me_metas[txn->mt_toggle]->mm_last_pg+1;
+			memcpy(txn->mt_dbs, env->me_metas[txn->mt_toggle]->mm_dbs, 2 * sizeof(MDB_db));
 		} else {
 			MDB_reader *r = (env->me_flags & MDB_NOTLS) ? txn->mt_u.reader :
 				pthread_getspecific(env->me_txkey);
@@ -1821,42 +2602,103 @@ mdb_txn_renew0(MDB_txn *txn)
 				if (r->mr_pid != env->me_pid || r->mr_txnid != (txnid_t)-1)
 					return MDB_BAD_RSLOT;
 			} else {
+				MDB_txninfo *ti = env->me_txns;
 				pid_t pid = env->me_pid;
 				pthread_t tid = pthread_self();
-
+				int dead = 0;
+#ifdef MDB_CAS
+				unsigned n;
+
+claim:
+				/* Claim the first free slot at or after the hint */
+				i = ti->mti_rhint;
+				for (n = env->me_maxreaders; n; n--, i++) {
+					if (i >= env->me_maxreaders)
+						i = 0;
+					if (!ti->mti_readers[i].mr_pid &&
+						MDB_CAS(&ti->mti_readers[i].mr_pid, 0, pid))
+						break;
+				}
+				if (!n) {
+					/* Crashed processes may have left slots behind */
+					if (!dead && (env->me_flags & MDB_READERCHECK) &&
+						!mdb_reader_check0(env, &dead) && dead)
+						goto claim;
+					return MDB_READERS_FULL;
+				}
+				ti->mti_rhint = i+1;
+				ti->mti_readers[i].mr_tid = tid;
+				/* Make sure writers scanning the table will see this slot */
+				while ((n = ti->mti_numreaders) <= i &&
+					!MDB_CAS(&ti->mti_numreaders, n, i+1))
+					;
+				env->me_numreaders = ti->mti_numreaders;
+#else
+claim:
 				LOCK_MUTEX_R(env);
-				for (i=0; i<env->me_txns->mti_numreaders; i++)
-					if (env->me_txns->mti_readers[i].mr_pid == 0)
+				for (i=0; i<ti->mti_numreaders; i++)
+					if (ti->mti_readers[i].mr_pid == 0)
 						break;
 				if (i == env->me_maxreaders) {
 					UNLOCK_MUTEX_R(env);
+					/* Crashed processes may have left slots behind */
+					if (!dead && (env->me_flags & MDB_READERCHECK) &&
+						!mdb_reader_check0(env, &dead) && dead)
+						goto claim;
 					return MDB_READERS_FULL;
 				}
-				env->me_txns->mti_readers[i].mr_pid = pid;
-				env->me_txns->mti_readers[i].mr_tid = tid;
-				if (i >= env->me_txns->mti_numreaders)
-					env->me_txns->mti_numreaders = i+1;
-				/* Save numreaders for un-mutexed mdb_env_close() */
-				env->me_numreaders = env->me_txns->mti_numreaders;
+				ti->mti_readers[i].mr_pid = pid;
+				ti->mti_readers[i].mr_tid = tid;
+				if (i >= ti->mti_numreaders)
+					ti->mti_numreaders = i+1;
+				env->me_numreaders = ti->mti_numreaders;
 				UNLOCK_MUTEX_R(env);
-				r = &env->me_txns->mti_readers[i];
+#endif
+				r = &ti->mti_readers[i];
 				new_notls = (env->me_flags & MDB_NOTLS);
 				if (!new_notls && (rc=pthread_setspecific(env->me_txkey, r))) {
 					r->mr_pid = 0;
 					return rc;
 				}
 			}
-			txn->mt_txnid = r->mr_txnid = env->me_txns->mti_txnid;
+			/* Retry if a newer txn was published meanwhile. A writer
+			 * that scanned the table before our txnid was visible may
+			 * be reusing the pages of our snapshot, and the one after
+			 * that may be overwriting the meta page we're copying.
+			 */
+			do {
+				txn->mt_txnid = r->mr_txnid = env->me_txns->mti_txnid;
+				MDB_FENCE();
+				txn->mt_toggle = txn->mt_txnid & 1;
+				txn->mt_next_pgno = env->me_metas[txn->mt_toggle]->mm_last_pg+1;
+				memcpy(txn->mt_dbs, env->me_metas[txn->mt_toggle]->mm_dbs, 2 * sizeof(MDB_db));
+				MDB_FENCE();
+			} while (txn->mt_txnid != env->me_txns->mti_txnid);
 			txn->mt_u.reader = r;
 		}
-		txn->mt_toggle = txn->mt_txnid & 1;
-		txn->mt_next_pgno = env->me_metas[txn->mt_toggle]->mm_last_pg+1;
 	} else {
 		LOCK_MUTEX_W(env);
 
-		txn->mt_txnid = env->me_txns->mti_txnid;
-		txn->mt_toggle = txn->mt_txnid & 1;
-		txn->mt_next_pgno = env->me_metas[txn->mt_toggle]->mm_last_pg+1;
+#ifndef _WIN32
+		if (env->me_flags & MDB_PIPELINE) {
+			/* Build on the pending txn if it isn't published yet */
+			pthread_mutex_lock(&env->me_pmutex);
+			if (env->me_pendtxnid) {
+				pend = 1;
+				txn->mt_txnid = env->me_pendtxnid;
+				txn->mt_toggle = txn->mt_txnid & 1;
+				txn->mt_next_pgno = env->me_pendlast+1;
+				memcpy(txn->mt_dbs, env->me_penddbs, 2 * sizeof(MDB_db));
+			}
+			pthread_mutex_unlock(&env->me_pmutex);
+		}
+#endif
+		if (!pend) {
+			txn->mt_txnid = env->me_txns->mti_txnid;
+			txn->mt_toggle = txn->mt_txnid & 1;
+			txn->mt_next_pgno = env->me_metas[txn->mt_toggle]->mm_last_pg+1;
+			memcpy(txn->mt_dbs, env->me_metas[txn->mt_toggle]->mm_dbs, 2 * sizeof(MDB_db));
+		}
 		txn->mt_txnid++;
 #if MDB_DEBUG
 		if (txn->mt_txnid == mdb_debug_start)
@@ -1865,13 +2707,14 @@ mdb_txn_renew0(MDB_txn *txn)
 		txn->mt_dirty_room = MDB_IDL_UM_MAX;
 		txn->mt_u.dirty_list = env->me_dirty_list;
 		txn->mt_u.dirty_list[0].mid = 0;
+		txn->mt_dirty_hash = env->me_dirty_hash;
+		mdb_dlist_reindex(txn);
 		txn->mt_free_pgs = env->me_free_pgs;
 		txn->mt_free_pgs[0] = 0;
 		env->me_txn = txn;
 	}
 
-	/* Copy the DB info and flags */
-	memcpy(txn->mt_dbs, env->me_metas[txn->mt_toggle]->mm_dbs, 2 * sizeof(MDB_db));
+	/* Copy the DB flags */
 	for (i=2; i<txn->mt_numdbs; i++) {
 		x = env->me_dbflags[i];
 		txn->mt_dbs[i].md_flags = x & PERSISTENT_FLAGS;
@@ -1957,9 +2800,11 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 	if (parent) {
 		unsigned int i;
 		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*MDB_IDL_UM_SIZE);
-		if (!txn->mt_u.dirty_list ||
+		txn->mt_dirty_hash = calloc(1, sizeof(MDB_dhash));
+		if (!txn->mt_u.dirty_list || !txn->mt_dirty_hash ||
 			!(txn->mt_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)))
 		{
+			free(txn->mt_dirty_hash);
 			free(txn->mt_u.dirty_list);
 			free(txn);
 			return ENOMEM;
@@ -1968,6 +2813,7 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		txn->mt_toggle = parent->mt_toggle;
 		txn->mt_dirty_room = parent->mt_dirty_room;
 		txn->mt_u.dirty_list[0].mid = 0;
+		mdb_dlist_reindex(txn);
 		txn->mt_free_pgs[0] = 0;
 		txn->mt_next_pgno = parent->mt_next_pgno;
 		parent->mt_child = txn;
@@ -2009,6 +2855,14 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 	return rc;
 }
 
+size_t
+mdb_txn_id(MDB_txn *txn)
+{
+	if (!txn)
+		return 0;
+	return txn->mt_txnid;
+}
+
 /** Export or close DBI handles opened in this txn. */
 static void
 mdb_dbis_update(MDB_txn *txn, int keep)
@@ -2061,12 +2915,15 @@ mdb_txn_reset0(MDB_txn *txn)
 		if (!(env->me_flags & MDB_WRITEMAP)) {
 			mdb_dlist_free(txn);
 		}
+		mdb_midl_free(txn->mt_spill_pgs);
+		txn->mt_spill_pgs = NULL;
 		free(env->me_pgfree);
 
 		if (txn->mt_parent) {
 			txn->mt_parent->mt_child = NULL;
 			env->me_pgstate = ((MDB_ntxn *)txn)->mnt_pgstate;
 			mdb_midl_free(txn->mt_free_pgs);
+			free(txn->mt_dirty_hash);
 			free(txn->mt_u.dirty_list);
 			return;
 		} else {
@@ -2115,24 +2972,86 @@ mdb_txn_abort(MDB_txn *txn)
 
 	mdb_txn_reset0(txn);
 	/* Free reader slot tied to this txn (if MDB_NOTLS && writable FS) */
-	if ((txn->mt_flags & MDB_TXN_RDONLY) && txn->mt_u.reader)
+	if ((txn->mt_flags & MDB_TXN_RDONLY) && txn->mt_u.reader) {
+		MDB_txninfo *ti = txn->mt_env->me_txns;
 		txn->mt_u.reader->mr_pid = 0;
+		/* Let the next reader reuse the slot */
+		ti->mti_rhint = txn->mt_u.reader - ti->mti_readers;
+	}
+
+	free(txn);
+}
+
+#ifndef _WIN32
+/** Finish committing a write transaction in #MDB_PIPELINE mode.
+ * The transaction's dirty pages have already been written. Record it
+ * as the base for the next writer and release the write lock, then
+ * flush and write its meta page while the next transaction is being
+ * built. Only one transaction is pending at a time, so meta pages are
+ * still written in txnid order and each commit's flush covers all of
+ * its own pages.
+ * @param[in] txn the transaction that's being committed
+ * @param[in] written bytes to count towards background sync, or 0
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_txn_publish(MDB_txn *txn, size_t written)
+{
+	MDB_env *env = txn->mt_env;
+	int rc;
+
+	pthread_mutex_lock(&env->me_pmutex);
+	while (env->me_pendtxnid)
+		pthread_cond_wait(&env->me_pcond, &env->me_pmutex);
+	if (env->me_flags & MDB_FATAL_ERROR) {
+		/* Our parent txn never made it to disk */
+		pthread_mutex_unlock(&env->me_pmutex);
+		mdb_txn_abort(txn);
+		return MDB_PANIC;
+	}
+	env->me_pendtxnid = txn->mt_txnid;
+	env->me_pendlast = txn->mt_next_pgno - 1;
+	env->me_penddbs[0] = txn->mt_dbs[0];
+	env->me_penddbs[1] = txn->mt_dbs[1];
+	pthread_mutex_unlock(&env->me_pmutex);
+
+	env->me_pglast = 0;
+	env->me_txn = NULL;
+	mdb_dbis_update(txn, 1);
+	UNLOCK_MUTEX_W(env);
+
+	if ((rc = mdb_env_sync(env, 0)) == MDB_SUCCESS)
+		rc = mdb_env_write_meta(txn);
+
+	pthread_mutex_lock(&env->me_pmutex);
+	if (rc)
+		env->me_flags |= MDB_FATAL_ERROR;
+	else if (!(env->me_flags & (MDB_NOSYNC|MDB_NOMETASYNC)) &&
+		env->me_durable < txn->mt_txnid)
+		env->me_durable = txn->mt_txnid;
+	env->me_pendtxnid = 0;
+	if (!rc)
+		env->me_unsynced += written;
+	pthread_cond_broadcast(&env->me_pcond);
+	pthread_mutex_unlock(&env->me_pmutex);
 
 	free(txn);
+	return rc;
 }
+#endif
 
 int
 mdb_txn_commit(MDB_txn *txn)
 {
-	int		 n, done;
+	int		 n;
 	unsigned int i;
 	ssize_t		 rc;
-	off_t		 size;
 	MDB_page	*dp;
 	MDB_env	*env;
-	pgno_t	next, freecnt;
+	pgno_t	freecnt;
 	txnid_t	oldpg_txnid, id;
 	MDB_cursor mc;
+	size_t	written = 0;
 
 	assert(txn != NULL);
 	assert(txn->mt_env != NULL);
@@ -2165,7 +3084,7 @@ mdb_txn_commit(MDB_txn *txn)
 
 	if (txn->mt_parent) {
 		MDB_txn *parent = txn->mt_parent;
-		unsigned x, y, len;
+		unsigned x;
 		MDB_ID2L dst, src;
 
 		/* Append our free list to parent's */
@@ -2192,37 +3111,19 @@ mdb_txn_commit(MDB_txn *txn)
 			txn->mt_parent->mt_dbflags[i] = txn->mt_dbflags[i] | x;
 		}
 
-		dst = txn->mt_parent->mt_u.dirty_list;
+		/* Merge our dirty list with parent's */
+		dst = parent->mt_u.dirty_list;
 		src = txn->mt_u.dirty_list;
-		/* Find len = length of merging our dirty list with parent's */
-		x = dst[0].mid;
-		dst[0].mid = 0;		/* simplify loops */
-		if (parent->mt_parent) {
-			len = x + src[0].mid;
-			y = mdb_mid2l_search(src, dst[x].mid + 1) - 1;
-			for (i = x; y && i; y--) {
-				pgno_t yp = src[y].mid;
-				while (yp < dst[i].mid)
-					i--;
-				if (yp == dst[i].mid) {
-					i--;
-					len--;
-				}
+		for (i=1; i<=src[0].mid; i++) {
+			if ((x = mdb_dlist_find(parent, src[i].mid)) != 0) {
+				/* our copy of the page replaces the parent's */
+				free(dst[x].mptr);
+				dst[x].mptr = src[i].mptr;
+			} else {
+				mdb_dlist_append(parent, &src[i]);
 			}
-		} else { /* Simplify the above for single-ancestor case */
-			len = MDB_IDL_UM_MAX - txn->mt_dirty_room;
 		}
-		/* Merge our dirty list with parent's */
-		y = src[0].mid;
-		for (i = len; y; dst[i--] = src[y--]) {
-			pgno_t yp = src[y].mid;
-			while (yp < dst[x].mid)
-				dst[i--] = dst[x--];
-			if (yp == dst[x].mid)
-				free(dst[x--].mptr);
-		}
-		assert(i == x);
-		dst[0].mid = len;
+		free(txn->mt_dirty_hash);
 		free(txn->mt_u.dirty_list);
 		parent->mt_dirty_room = txn->mt_dirty_room;
 
@@ -2408,116 +3309,44 @@ free2:
 	mdb_audit(txn);
 #endif
 
-	if (env->me_flags & MDB_WRITEMAP) {
+	if (env->me_flags & MDB_ENV_SYNCER) {
+		/* Count the meta page and dirty pages for mdb_env_syncer_add() */
+		written = 1;
 		for (i=1; i<=txn->mt_u.dirty_list[0].mid; i++) {
 			dp = txn->mt_u.dirty_list[i].mptr;
-			/* clear dirty flag */
-			dp->mp_flags &= ~P_DIRTY;
+			written += IS_OVERFLOW(dp) ? dp->mp_pages : 1;
 		}
-		txn->mt_u.dirty_list[0].mid = 0;
-		goto sync;
+		/* Spilled pages were written earlier in the txn */
+		if (txn->mt_spill_pgs)
+			written += txn->mt_spill_pgs[0];
+		written *= env->me_psize;
 	}
 
-	/* Commit up to MDB_COMMIT_PAGES dirty pages to disk until done.
-	 */
-	next = 0;
-	i = 1;
-	do {
-#ifdef _WIN32
-		/* Windows actually supports scatter/gather I/O, but only on
-		 * unbuffered file handles. Since we're relying on the OS page
-		 * cache for all our data, that's self-defeating. So we just
-		 * write pages one at a time. We use the ov structure to set
-		 * the write offset, to at least save the overhead of a Seek
-		 * system call.
-		 */
-		OVERLAPPED ov;
-		memset(&ov, 0, sizeof(ov));
-		for (; i<=txn->mt_u.dirty_list[0].mid; i++) {
-			size_t wsize;
-			dp = txn->mt_u.dirty_list[i].mptr;
-			DPRINTF("committing page %zu", dp->mp_pgno);
-			size = dp->mp_pgno * env->me_psize;
-			ov.Offset = size & 0xffffffff;
-			ov.OffsetHigh = size >> 16;
-			ov.OffsetHigh >>= 16;
-			/* clear dirty flag */
-			dp->mp_flags &= ~P_DIRTY;
-			wsize = env->me_psize;
-			if (IS_OVERFLOW(dp)) wsize *= dp->mp_pages;
-			rc = WriteFile(env->me_fd, dp, wsize, NULL, &ov);
-			if (!rc) {
-				n = ErrCode();
-				DPRINTF("WriteFile: %d", n);
-				mdb_txn_abort(txn);
-				return n;
-			}
-		}
-		done = 1;
-#else
-		struct iovec	 iov[MDB_COMMIT_PAGES];
-		n = 0;
-		done = 1;
-		size = 0;
-		for (; i<=txn->mt_u.dirty_list[0].mid; i++) {
-			dp = txn->mt_u.dirty_list[i].mptr;
-			if (dp->mp_pgno != next) {
-				if (n) {
-					rc = writev(env->me_fd, iov, n);
-					if (rc != size) {
-						n = ErrCode();
-						if (rc > 0)
-							DPUTS("short write, filesystem full?");
-						else
-							DPRINTF("writev: %s", strerror(n));
-						mdb_txn_abort(txn);
-						return n;
-					}
-					n = 0;
-					size = 0;
-				}
-				lseek(env->me_fd, dp->mp_pgno * env->me_psize, SEEK_SET);
-				next = dp->mp_pgno;
-			}
-			DPRINTF("committing page %zu", dp->mp_pgno);
-			iov[n].iov_len = env->me_psize;
-			if (IS_OVERFLOW(dp)) iov[n].iov_len *= dp->mp_pages;
-			iov[n].iov_base = (char *)dp;
-			size += iov[n].iov_len;
-			next = dp->mp_pgno + (IS_OVERFLOW(dp) ? dp->mp_pages : 1);
-			/* clear dirty flag */
-			dp->mp_flags &= ~P_DIRTY;
-			if (++n >= MDB_COMMIT_PAGES) {
-				done = 0;
-				i++;
-				break;
-			}
-		}
-
-		if (n == 0)
-			break;
+	if ((n = mdb_page_flush(txn)) != MDB_SUCCESS) {
+		mdb_txn_abort(txn);
+		return n;
+	}
+	mdb_midl_free(txn->mt_spill_pgs);
+	txn->mt_spill_pgs = NULL;
 
-		rc = writev(env->me_fd, iov, n);
-		if (rc != size) {
-			n = ErrCode();
-			if (rc > 0)
-				DPUTS("short write, filesystem full?");
-			else
-				DPRINTF("writev: %s", strerror(n));
-			mdb_txn_abort(txn);
-			return n;
-		}
+#ifndef _WIN32
+	if (env->me_flags & MDB_PIPELINE)
+		return mdb_txn_publish(txn, written);
 #endif
-	} while (!done);
 
-	mdb_dlist_free(txn);
-
-sync:
 	if ((n = mdb_env_sync(env, 0)) != 0 ||
 	    (n = mdb_env_write_meta(txn)) != MDB_SUCCESS) {
 		mdb_txn_abort(txn);
+		mdb_env_set_durable(env, 0);
 		return n;
 	}
+	if (!(env->me_flags & (MDB_NOSYNC|MDB_NOMETASYNC)) &&
+		!((env->me_flags & MDB_WRITEMAP) && (env->me_flags & MDB_MAPASYNC)))
+		mdb_env_set_durable(env, txn->mt_txnid);
+#ifndef _WIN32
+	if (written)
+		mdb_env_syncer_add(env, written);
+#endif
 
 done:
 	env->me_pglast = 0;
@@ -2800,6 +3629,10 @@ mdb_env_create(MDB_env **env)
 	e->me_wmutex = SEM_FAILED;
 #endif
 	e->me_pid = getpid();
+#ifndef _WIN32
+	pthread_mutex_init(&e->me_pmutex, NULL);
+	pthread_cond_init(&e->me_pcond, NULL);
+#endif
 	VGMEMP_CREATE(e,0,0);
 	*env = e;
 	return MDB_SUCCESS;
@@ -2825,6 +3658,20 @@ mdb_env_set_maxdbs(MDB_env *env, MDB_dbi dbs)
 	return MDB_SUCCESS;
 }
 
+int
+mdb_env_set_syncparams(MDB_env *env, unsigned int interval, size_t bytes)
+{
+#ifdef _WIN32
+	return EINVAL;
+#else
+	if (env->me_map)
+		return EINVAL;
+	env->me_sync_interval = interval;
+	env->me_sync_bytes = bytes;
+	return MDB_SUCCESS;
+#endif
+}
+
 int
 mdb_env_set_maxreaders(MDB_env *env, unsigned int readers)
 {
@@ -2843,6 +3690,18 @@ mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers)
 	return MDB_SUCCESS;
 }
 
+int
+mdb_reader_check(MDB_env *env, int *dead)
+{
+	if (!env)
+		return EINVAL;
+	if (dead)
+		*dead = 0;
+	if (!env->me_txns)
+		return MDB_SUCCESS;
+	return mdb_reader_check0(env, dead);
+}
+
 /** Further setup required for opening an MDB environment
  */
 static int
@@ -2953,6 +3812,7 @@ mdb_env_open2(MDB_env *env)
 	p = (MDB_page *)env->me_map;
 	env->me_metas[0] = METADATA(p);
 	env->me_metas[1] = (MDB_meta *)((char *)env->me_metas[0] + meta.mm_psize);
+	env->me_durable = env->me_metas[mdb_env_pick_meta(env)]->mm_txnid;
 
 #if MDB_DEBUG
 	{
@@ -3374,10 +4234,11 @@ mdb_env_setup_locks(MDB_env *env, char *lpath, int mode, int *excl)
 		pthread_mutexattr_destroy(&mattr);
 #endif	/* _WIN32 || MDB_USE_POSIX_SEM */
 
-		env->me_txns->mti_version = MDB_VERSION;
+		env->me_txns->mti_version = MDB_LOCK_VERSION;
 		env->me_txns->mti_magic = MDB_MAGIC;
 		env->me_txns->mti_txnid = 0;
 		env->me_txns->mti_numreaders = 0;
+		env->me_txns->mti_rhint = 0;
 
 	} else {
 		if (env->me_txns->mti_magic != MDB_MAGIC) {
@@ -3385,9 +4246,9 @@ mdb_env_setup_locks(MDB_env *env, char *lpath, int mode, int *excl)
 			rc = MDB_INVALID;
 			goto fail;
 		}
-		if (env->me_txns->mti_version != MDB_VERSION) {
+		if (env->me_txns->mti_version != MDB_LOCK_VERSION) {
 			DPRINTF("lock region is version %u, expected version %u",
-				env->me_txns->mti_version, MDB_VERSION);
+				env->me_txns->mti_version, MDB_LOCK_VERSION);
 			rc = MDB_VERSION_MISMATCH;
 			goto fail;
 		}
@@ -3425,8 +4286,8 @@ fail:
 	 *	at runtime. Changing other flags requires closing the
 	 *	environment and re-opening it with the new flags.
 	 */
-#define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC)
-#define	CHANGELESS	(MDB_FIXEDMAP|MDB_NOSUBDIR|MDB_RDONLY|MDB_WRITEMAP|MDB_NOTLS)
+#define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC|MDB_READERCHECK)
+#define	CHANGELESS	(MDB_FIXEDMAP|MDB_NOSUBDIR|MDB_RDONLY|MDB_WRITEMAP|MDB_NOTLS|MDB_PIPELINE)
 
 int
 mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode)
@@ -3436,6 +4297,13 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 
 	if (env->me_fd!=INVALID_HANDLE_VALUE || (flags & ~(CHANGEABLE|CHANGELESS)))
 		return EINVAL;
+#ifdef _WIN32
+	if (flags & MDB_PIPELINE)
+		return EINVAL;
+#else
+	if ((flags & MDB_PIPELINE) && (flags & MDB_WRITEMAP))
+		return EINVAL;
+#endif
 
 	len = strlen(path);
 	if (flags & MDB_NOSUBDIR) {
@@ -3463,7 +4331,8 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 		flags &= ~MDB_WRITEMAP;
 	} else {
 		if (!((env->me_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)) &&
-			  (env->me_dirty_list = calloc(MDB_IDL_UM_SIZE, sizeof(MDB_ID2)))))
+			  (env->me_dirty_list = calloc(MDB_IDL_UM_SIZE, sizeof(MDB_ID2))) &&
+			  (env->me_dirty_hash = calloc(1, sizeof(MDB_dhash)))))
 			rc = ENOMEM;
 	}
 	env->me_flags = flags |= MDB_ENV_ACTIVE;
@@ -3529,6 +4398,14 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 		if (excl > 0) {
 			rc = mdb_env_share_locks(env, &excl);
 		}
+#ifndef _WIN32
+		if (!rc && !(flags & MDB_RDONLY) &&
+			(env->me_sync_interval || env->me_sync_bytes)) {
+			rc = pthread_create(&env->me_sync_thr, NULL, mdb_env_syncer, env);
+			if (!rc)
+				env->me_flags |= MDB_ENV_SYNCER;
+		}
+#endif
 	}
 
 leave:
@@ -3555,6 +4432,7 @@ mdb_env_close0(MDB_env *env, int excl)
 	free(env->me_dbflags);
 	free(env->me_dbxs);
 	free(env->me_path);
+	free(env->me_dirty_hash);
 	free(env->me_dirty_list);
 	if (env->me_free_pgs)
 		mdb_midl_free(env->me_free_pgs);
@@ -3583,8 +4461,10 @@ mdb_env_close0(MDB_env *env, int excl)
 		pid_t pid = env->me_pid;
 		/* Clearing readers is done in this function because
 		 * me_txkey with its destructor must be disabled first.
+		 * Readers claim slots without locking, so scan every slot
+		 * that may have been used rather than trust me_numreaders.
 		 */
-		for (i = env->me_numreaders; --i >= 0; )
+		for (i = env->me_txns->mti_numreaders; --i >= 0; )
 			if (env->me_txns->mti_readers[i].mr_pid == pid)
 				env->me_txns->mti_readers[i].mr_pid = 0;
 #ifdef _WIN32
@@ -3763,6 +4643,19 @@ mdb_env_close(MDB_env *env)
 	if (env == NULL)
 		return;
 
+#ifndef _WIN32
+	if (env->me_flags & MDB_ENV_SYNCER) {
+		pthread_mutex_lock(&env->me_pmutex);
+		env->me_sync_stop = 1;
+		pthread_cond_broadcast(&env->me_pcond);
+		pthread_mutex_unlock(&env->me_pmutex);
+		pthread_join(env->me_sync_thr, NULL);
+		env->me_flags &= ~MDB_ENV_SYNCER;
+		if (env->me_unsynced && !(env->me_flags & MDB_FATAL_ERROR))
+			mdb_env_sync(env, 1);
+	}
+#endif
+
 	VGMEMP_DESTROY(env);
 	while ((dp = env->me_dpages) != NULL) {
 		VGMEMP_DEFINED(&dp->mp_next, sizeof(dp->mp_next));
@@ -3771,6 +4664,10 @@ mdb_env_close(MDB_env *env)
 	}
 
 	mdb_env_close0(env, 0);
+#ifndef _WIN32
+	pthread_cond_destroy(&env->me_pcond);
+	pthread_mutex_destroy(&env->me_pmutex);
+#endif
 	free(env);
 }
 
@@ -4033,8 +4930,8 @@ mdb_page_get(MDB_txn *txn, pgno_t pgno, MDB_page **ret, int *lvl)
 		do {
 			MDB_ID2L dl = tx2->mt_u.dirty_list;
 			if (dl[0].mid) {
-				unsigned x = mdb_mid2l_search(dl, pgno);
-				if (x <= dl[0].mid && dl[x].mid == pgno) {
+				unsigned x = mdb_dlist_find(tx2, pgno);
+				if (x) {
 					p = dl[x].mptr;
 					goto done;
 				}
@@ -4158,6 +5055,47 @@ mdb_page_search_lowest(MDB_cursor *mc)
 	return mdb_page_search_root(mc, NULL, 0);
 }
 
+/** Search for the page a given key should be in, starting from the
+ * cursor's current position instead of the root.
+ * The key must sort after every key on the cursor's current leaf page.
+ * The cursor stack is popped back to the lowest ancestor whose subtree
+ * covers the key, and the search continues downward from there. For
+ * ascending batches of nearby keys this touches far fewer pages than
+ * #mdb_page_search().
+ * @param[in,out] mc An initialized cursor.
+ * @param[in] key The key to search for.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_search_finger(MDB_cursor *mc, MDB_val *key)
+{
+	MDB_page	*mp;
+	MDB_node	*node;
+	MDB_val		 nodekey;
+	int			 i;
+
+	/* Since the key is past the current leaf, it is within the subtree
+	 * at level i+1 iff it sorts before the next separator at level i.
+	 * Levels whose index is already rightmost inherit their upper
+	 * bound from above.
+	 */
+	for (i = mc->mc_top - 1; i >= 0; i--) {
+		mp = mc->mc_pg[i];
+		if (mc->mc_ki[i] + 1U < NUMKEYS(mp)) {
+			node = NODEPTR(mp, mc->mc_ki[i] + 1);
+			MDB_GET_KEY(node, &nodekey);
+			if (mc->mc_dbx->md_cmp(key, &nodekey) < 0)
+				break;
+		}
+	}
+
+	mc->mc_top = i + 1;
+	mc->mc_snum = mc->mc_top + 1;
+	DPRINTF("finger search restarting at level %u, page %zu",
+	    mc->mc_top, mc->mc_pg[mc->mc_top]->mp_pgno);
+	return mdb_page_search_root(mc, key, 0);
+}
+
 /** Search for the page a given key should be in.
  * Pushes parent pages on the cursor stack. This function just sets up
  * the search; it finds the root page for \b mc's database and sets this
@@ -4598,6 +5536,17 @@ mdb_cursor_set(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 				mc->mc_ki[mc->mc_top] = nkeys;
 				return MDB_NOTFOUND;
 			}
+			/* Key is to the right of this page. Search from the
+			 * nearest ancestor covering it rather than the root.
+			 */
+			if (!(mc->mc_txn->mt_flags & MDB_TXN_ERROR) &&
+				!(*mc->mc_dbflag & DB_STALE)) {
+				if ((rc = mdb_page_search_finger(mc, key)) != MDB_SUCCESS)
+					return rc;
+				mp = mc->mc_pg[mc->mc_top];
+				assert(IS_LEAF(mp));
+				goto set2;
+			}
 		}
 		if (!mc->mc_top) {
 			/* There are no other pages */
@@ -4990,7 +5939,8 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		MDB_page *np;
 		/* new database, write a root leaf page */
 		DPUTS("allocating new root leaf page");
-		if ((rc = mdb_page_new(mc, P_LEAF, 1, &np))) {
+		if ((rc = mdb_page_spill(mc, key, data)) ||
+			(rc = mdb_page_new(mc, P_LEAF, 1, &np))) {
 			return rc;
 		}
 		mc->mc_snum = 0;
@@ -5032,9 +5982,9 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 			return rc;
 	}
 
-	/* Cursor is positioned, now make sure all pages are writable */
-	rc2 = mdb_cursor_touch(mc);
-	if (rc2)
+	/* Cursor is positioned, make room and make sure all pages are writable */
+	if ((rc2 = mdb_page_spill(mc, key, data)) ||
+		(rc2 = mdb_cursor_touch(mc)))
 		return rc2;
 
 top:
@@ -5205,7 +6155,7 @@ current:
 						return ENOMEM;
 					id2.mid = pg;
 					id2.mptr = np;
-					mdb_mid2l_insert(mc->mc_txn->mt_u.dirty_list, &id2);
+					mdb_dlist_append(mc->mc_txn, &id2);
 					if (!(flags & MDB_RESERVE)) {
 						/* Copy end of page, adjusting alignment so
 						 * compiler may copy words instead of bytes.
@@ -5375,8 +6325,8 @@ mdb_cursor_del(MDB_cursor *mc, unsigned int flags)
 	if (!(mc->mc_flags & C_INITIALIZED))
 		return EINVAL;
 
-	rc = mdb_cursor_touch(mc);
-	if (rc)
+	if ((rc = mdb_page_spill(mc, NULL, NULL)) ||
+		(rc = mdb_cursor_touch(mc)))
 		return rc;
 
 	leaf = NODEPTR(mc->mc_pg[mc->mc_top], mc->mc_ki[mc->mc_top]);
@@ -7266,6 +8216,15 @@ int mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *arg)
 	return mdb_stat0(txn->mt_env, &txn->mt_dbs[dbi], arg);
 }
 
+int mdb_dbi_flags(MDB_txn *txn, MDB_dbi dbi, unsigned int *flags)
+{
+	if (txn == NULL || flags == NULL || dbi >= txn->mt_numdbs)
+		return EINVAL;
+
+	*flags = txn->mt_dbs[dbi].md_flags & PERSISTENT_FLAGS;
+	return MDB_SUCCESS;
+}
+
 void mdb_dbi_close(MDB_env *env, MDB_dbi dbi)
 {
 	char *ptr;
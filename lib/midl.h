@@ -68,6 +68,13 @@ typedef MDB_ID *MDB_IDL;
 #define MDB_IDL_FIRST( ids )	( (ids)[1] )
 #define MDB_IDL_LAST( ids )		( (ids)[(ids)[0]] )
 
+	/** Search for an ID in an IDL.
+	 * @param[in] ids	The IDL to search, sorted by #mdb_midl_sort().
+	 * @param[in] id	The ID to search for.
+	 * @return	The index of the first ID not greater than \b id.
+	 */
+unsigned mdb_midl_search( MDB_IDL ids, MDB_ID id );
+
 #if 0	/* superseded by append/sort */
 	/** Insert an ID into an IDL.
 	 * @param[in,out] ids	The IDL to insert into.
@@ -158,6 +165,12 @@ int mdb_mid2l_insert( MDB_ID2L ids, MDB_ID2 *id );
 	 */
 int mdb_mid2l_append( MDB_ID2L ids, MDB_ID2 *id );
 
+	/** Sort an ID2L.
+	 * Restores the ascending order of an ID2L built by appending.
+	 * @param[in,out] ids	The ID2L to sort.
+	 */
+void mdb_mid2l_sort( MDB_ID2L ids );
+
 /** @} */
 /** @} */
 #ifdef __cplusplus
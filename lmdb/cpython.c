@@ -21,11 +21,18 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <tgmath.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "Python.h"
 #include "structmember.h"
@@ -51,6 +58,10 @@ static int drop_gil = 0;
 
 enum string_id {
     APPEND_S,
+    AS_DICT_S,
+    AUTO_READER_CHECK_S,
+    BATCH_S,
+    BUFFER_S,
     BUFFERS_S,
     CREATE_S,
     DB_S,
@@ -59,26 +70,49 @@ enum string_id {
     DUPDATA_S,
     DUPSORT_S,
     FORCE_S,
+    GIL_POLICY_S,
+    GROUP_COMMIT_S,
+    INCLUDE_STOP_S,
     ITEMS_S,
     ITERITEMS_S,
     KEY_S,
     KEYS_S,
+    LENGTH_S,
+    LIMIT_S,
     MAP_ASYNC_S,
     MAP_SIZE_S,
+    MAX_BYTES_S,
     MAX_DBS_S,
+    MAX_ITEMS_S,
     MAX_READERS_S,
+    MAX_SPARE_CURSORS_S,
+    MAX_SPARE_ITERS_S,
+    MAX_SPARE_TXNS_S,
+    MAX_STALENESS_S,
     METASYNC_S,
     MODE_S,
     NAME_S,
+    OFFSET_S,
     OVERWRITE_S,
     PARENT_S,
     PATH_S,
+    PIPELINE_S,
+    PREFIX_S,
     READONLY_S,
     REVERSE_S,
     REVERSE_KEY_S,
+    SEQUENTIAL_S,
+    SIZE_S,
+    SORT_S,
+    START_S,
+    STOP_S,
     SUBDIR_S,
     SYNC_S,
+    SYNC_BYTES_S,
+    SYNC_INTERVAL_S,
+    TIMEOUT_S,
     TXN_S,
+    TXNID_S,
     VALUE_S,
     VALUES_S,
     WRITE_S,
@@ -90,6 +124,10 @@ enum string_id {
 
 static const char *strings = (
     "append\0"
+    "as_dict\0"
+    "auto_reader_check\0"
+    "batch\0"
+    "buffer\0"
     "buffers\0"
     "create\0"
     "db\0"
@@ -98,26 +136,49 @@ static const char *strings = (
     "dupdata\0"
     "dupsort\0"
     "force\0"
+    "gil_policy\0"
+    "group_commit\0"
+    "include_stop\0"
     "items\0"
     "iteritems\0"
     "key\0"
     "keys\0"
+    "length\0"
+    "limit\0"
     "map_async\0"
     "map_size\0"
+    "max_bytes\0"
     "max_dbs\0"
+    "max_items\0"
     "max_readers\0"
+    "max_spare_cursors\0"
+    "max_spare_iters\0"
+    "max_spare_txns\0"
+    "max_staleness\0"
     "metasync\0"
     "mode\0"
     "name\0"
+    "offset\0"
     "overwrite\0"
     "parent\0"
     "path\0"
+    "pipeline\0"
+    "prefix\0"
     "readonly\0"
     "reverse\0"
     "reverse_key\0"
+    "sequential\0"
+    "size\0"
+    "sort\0"
+    "start\0"
+    "stop\0"
     "subdir\0"
     "sync\0"
+    "sync_bytes\0"
+    "sync_interval\0"
+    "timeout\0"
     "txn\0"
+    "txnid\0"
     "value\0"
     "values\0"
     "write\0"
@@ -133,35 +194,24 @@ extern PyTypeObject PyEnvironment_Type;
 extern PyTypeObject PyTransaction_Type;
 extern PyTypeObject PyCursor_Type;
 extern PyTypeObject PyIterator_Type;
+extern PyTypeObject PyBuf_Type;
+extern PyTypeObject PyReader_Type;
+extern PyTypeObject PyWriteBatch_Type;
 
 struct EnvObject;
 
+#if PY_VERSION_HEX >= 0x03070000
+#   define HAVE_FASTCALL
+#endif
+
 #if PY_MAJOR_VERSION >= 3
 
 // Python 3.3 kindly exports the struct definitions for us.
 #   define MOD_RETURN(mod) return mod;
 #   define MODINIT_NAME PyInit_cpython
-#   define BUFFER_TYPE PyMemoryViewObject
-#   define MAKE_BUFFER() PyMemoryView_FromMemory("", 0, PyBUF_READ)
-#   define SET_BUFFER(buff, ptr, size) {\
-        (buff)->view.buf = (ptr); \
-        (buff)->view.len = (size); \
-        (buff)->hash = -1; \
-    }
 
 #else
 
-// So evil.
-typedef struct {
-    PyObject_HEAD
-    PyObject *b_base;
-    void *b_ptr;
-    Py_ssize_t b_size;
-    Py_ssize_t b_offset;
-    int b_readonly;
-    long b_hash;
-} PyBufferObject;
-
 #   define PyUnicode_InternFromString PyString_InternFromString
 #   define PyBytes_AS_STRING PyString_AS_STRING
 #   define PyBytes_GET_SIZE PyString_GET_SIZE
@@ -169,13 +219,6 @@ typedef struct {
 #   define PyBytes_FromStringAndSize PyString_FromStringAndSize
 #   define MOD_RETURN(mod) return
 #   define MODINIT_NAME initcpython
-#   define BUFFER_TYPE PyBufferObject
-#   define MAKE_BUFFER() PyBuffer_FromMemory("", 0)
-#   define SET_BUFFER(buf, ptr, size) {\
-        (buf)->b_hash = -1; \
-        (buf)->b_ptr = (ptr); \
-        (buf)->b_size = (size); \
-    }
 
 #endif
 
@@ -276,20 +319,86 @@ typedef struct {
     MDB_dbi dbi;
 } DbObject;
 
+/*
+ * Per-thread read snapshot used by Environment.get() and gets() when
+ * max_staleness is set. Owned by a capsule in the thread's state dict, so it
+ * is released when the thread exits; also linked into the environment so it
+ * can be aborted when the environment is closed.
+ */
+struct snapshot {
+    struct snapshot *prev;
+    struct snapshot *next;
+    struct EnvObject *env; // Not refcounted; NULL once env is closed.
+    MDB_txn *txn;
+    size_t txnid;
+    uint64_t started; // Monotonic milliseconds.
+};
+
+enum gil_policy {
+    // Never release the GIL.
+    GIL_NEVER,
+    // Release the GIL only around operations that may block or run long.
+    GIL_AUTO,
+    // Release the GIL around every LMDB call.
+    GIL_ALWAYS
+};
+
 typedef struct EnvObject {
     LmdbObject_HEAD
     MDB_env *env;
     DbObject *main_db;
     int readonly; // If 1, transactions are always readonly.
+
+    // See save_thread().
+    int gil_policy;
+    size_t gil_released;
+    size_t gil_kept;
+
+    // Reset read-only MDB_txns awaiting mdb_txn_renew(), see env_txn_begin().
+    MDB_txn **spare_txns;
+    int max_spare_txns;
+    int spare_count;
+    size_t spare_hits;
+    size_t spare_misses;
+
+    // Bounded staleness for get()/gets(), see env_snapshot_txn().
+    int max_staleness; // -1 if disabled.
+    PyObject *snap_key; // Key in thread state dict.
+    struct snapshot *snapshots;
+    size_t snap_hits;
+    size_t snap_misses;
+
+    // Environment.write() requests awaiting a group commit, see group_write().
+    int group_commit;
+    pthread_mutex_t group_lock;
+    pthread_cond_t group_cond;
+    struct batch_ctx *group_head;
+    struct batch_ctx **group_tail;
+    int group_busy; // A leader is committing a group.
+    size_t group_commits;
+    size_t group_writes;
 } EnvObject;
 
+enum trans_flags {
+    // Transaction is read-only.
+    TRANS_RDONLY = 1,
+    // MDB_txn should be returned to EnvObject.spare_txns when finished.
+    TRANS_SPARE = 2,
+    // Transaction.reset() was called; only renew() is valid.
+    TRANS_RESET = 4
+};
+
+struct BufObject;
+
 typedef struct {
     LmdbObject_HEAD
     EnvObject *env;
 
     MDB_txn *txn;
+    int flags;
     int buffers;
-    BUFFER_TYPE *key_buf;
+    // Writable buffer returned by reserve(), invalidated by the next write.
+    struct BufObject *reserved;
 } TransObject;
 
 typedef struct {
@@ -298,13 +407,32 @@ typedef struct {
 
     int positioned;
     MDB_cursor *curs;
-    BUFFER_TYPE *key_buf;
-    BUFFER_TYPE *val_buf;
-    PyObject *item_tup;
     MDB_val key;
     MDB_val val;
+    int val_stale; // Moved by a key-only step, see cursor_load_val().
 } CursorObject;
 
+// Zero-copy view of a key or value, returned when a transaction was started
+// with buffers=True. Linked to the transaction so it is emptied when the
+// transaction ends, rather than continuing to point into the map.
+typedef struct BufObject {
+    LmdbObject_HEAD
+    TransObject *trans; // Not refcounted; NULL once invalid.
+    MDB_val val;
+    int writable; // Points into a dirty page, see trans_reserve().
+    int owned; // val.mv_data is malloc()ed and freed with the buffer.
+} BufObject;
+
+// Seekable file-like view of a value, returned by Transaction.open_value().
+// Holds a reference to the transaction, keeping it alive while the value is
+// streamed.
+typedef struct {
+    LmdbObject_HEAD
+    TransObject *trans;
+    MDB_val val;
+    size_t pos;
+} ReaderObject;
+
 
 // Iterator protocol requires 'next' public method, which we want to use for
 // MDB. So iterator needs to be a separate object to implement the protocol
@@ -316,12 +444,113 @@ typedef struct {
     int started;
     int op;
     PyObject *(*val_func)(CursorObject *);
+    // Only keys are returned and the database has no duplicates, so steps
+    // need not resolve values, see _cursor_move() and iter_fill().
+    int keys_only;
+
+    // Prefetched key/value pairs awaiting return, see iter_fill(). Only used
+    // in read-only transactions, since writes may move the referenced pages.
+    MDB_val *batch;
+    int batch_size; // Pairs, or 0 if unbatched.
+    int batch_pos;
+    int batch_len;
+    int batch_eof; // Cursor reached the end while filling the batch.
+
+    // Bounds checked before each element is returned, see iter_in_bounds().
+    int done; // A bound was reached; no more elements are returned.
+    int remaining; // Elements left to return, or -1 if unlimited.
+    int has_stop;
+    int include_stop;
+    MDB_val stop; // malloc()ed copy.
+    int has_prefix;
+    MDB_val prefix; // malloc()ed copy.
 } IterObject;
 
 
 
 
+// -------------------
+// Concurrency control
+// -------------------
+
+// Values at least this large are copied and written with the GIL released
+// under GIL_AUTO, since they are likely to span pages that are not resident.
+#define LARGE_VALUE (64 * 1024)
+
+// Whether an operation is cheap or potentially long running.
+#define GIL_CHEAP 0
+#define GIL_SLOW 1
+#define LARGE_COST(size) (((size) >= LARGE_VALUE) ? GIL_SLOW : GIL_CHEAP)
+
+/**
+ * Return the thread state saved by releasing the GIL if `env`'s policy calls
+ * for it given the operation's cost, otherwise NULL. enable_drop_gil()
+ * overrides the policy of every environment with GIL_ALWAYS.
+ */
+static PyThreadState *save_thread(EnvObject *env, int cost)
+{
+    int policy = drop_gil ? GIL_ALWAYS : env->gil_policy;
+    if(policy == GIL_ALWAYS || (policy == GIL_AUTO && cost == GIL_SLOW)) {
+        env->gil_released++;
+        return PyEval_SaveThread();
+    }
+    env->gil_kept++;
+    return NULL;
+}
+
+static void restore_thread(PyThreadState *state)
+{
+    if(state) {
+        PyEval_RestoreThread(state);
+    }
+}
+
+// Like Py_BEGIN_ALLOW_THREADS
+#define DROP_GIL(env, cost) \
+    { PyThreadState *_save; _save = save_thread(env, cost);
+
+// Like Py_END_ALLOW_THREADS
+#define LOCK_GIL \
+    restore_thread(_save); }
+
+#define UNLOCKED(out, env, cost, e) \
+    DROP_GIL(env, cost) \
+    out = (e); \
+    LOCK_GIL
+
+
+
 // ----------- helpers
+
+/**
+ * Growable malloc()ed buffer, appended to while the GIL is released.
+ */
+struct blob {
+    char *data;
+    size_t size;
+    size_t cap;
+};
+
+static int
+blob_append(struct blob *blob, const void *data, size_t size)
+{
+    if((blob->size + size) > blob->cap) {
+        size_t cap = blob->cap ? blob->cap : 4096;
+        while(cap < (blob->size + size)) {
+            cap *= 2;
+        }
+        char *p = realloc(blob->data, cap);
+        if(! p) {
+            return -1;
+        }
+        blob->data = p;
+        blob->cap = cap;
+    }
+    memcpy(blob->data + blob->size, data, size);
+    blob->size += size;
+    return 0;
+}
+
 //
 //
 //
@@ -376,28 +605,98 @@ dict_from_fields(void *o, const struct dict_field *fields)
 }
 
 
-static PyObject * NOINLINE
-buffer_from_val(BUFFER_TYPE **bufp, MDB_val *val)
+static PyObject *
+string_from_val(EnvObject *env, MDB_val *val)
 {
-    BUFFER_TYPE *buf = *bufp;
-    if(! buf) {
-        buf = (BUFFER_TYPE *) MAKE_BUFFER();
-        if(! buf) {
-            return NULL;
+    if(val->mv_size < LARGE_VALUE) {
+        return PyBytes_FromStringAndSize(val->mv_data, val->mv_size);
+    }
+    PyObject *s = PyBytes_FromStringAndSize(NULL, val->mv_size);
+    if(s) {
+        DROP_GIL(env, GIL_SLOW)
+        memcpy(PyBytes_AS_STRING(s), val->mv_data, val->mv_size);
+        LOCK_GIL
+    }
+    return s;
+}
+
+
+/**
+ * Copy `val` into the writable buffer-protocol object `obj` starting at
+ * `offset`, truncating it if it does not fit. Returns the number of bytes
+ * copied, or -1 on error.
+ */
+static Py_ssize_t
+copy_into_buffer(EnvObject *env, MDB_val *val, PyObject *obj, size_t offset)
+{
+    Py_buffer view;
+#if PY_MAJOR_VERSION < 3
+    if(! PyObject_CheckBuffer(obj)) {
+        // e.g. array.array, which only has the old buffer protocol.
+        void *buf;
+        Py_ssize_t len;
+        if(PyObject_AsWriteBuffer(obj, &buf, &len)) {
+            return -1;
         }
-        *bufp = buf;
+        PyBuffer_FillInfo(&view, NULL, buf, len, 0, PyBUF_WRITABLE);
+    } else
+#endif
+    if(PyObject_GetBuffer(obj, &view, PyBUF_WRITABLE)) {
+        return -1;
     }
 
-    SET_BUFFER(buf, val->mv_data, val->mv_size);
-    Py_INCREF(buf);
-    return (PyObject *) buf;
+    size_t avail = ((size_t) view.len > offset) ? (view.len - offset) : 0;
+    size_t size = (val->mv_size < avail) ? val->mv_size : avail;
+    DROP_GIL(env, LARGE_COST(size))
+    memcpy(((char *) view.buf) + offset, val->mv_data, size);
+    LOCK_GIL
+    PyBuffer_Release(&view);
+    return size;
 }
 
-
+/**
+ * Like copy_into_buffer(), but returns the full length of `val` so callers
+ * can detect truncation, or NULL on error.
+ */
 static PyObject *
-string_from_val(MDB_val *val)
+val_into_buffer(EnvObject *env, MDB_val *val, PyObject *obj, size_t offset)
+{
+    if(copy_into_buffer(env, val, obj, offset) == -1) {
+        return NULL;
+    }
+    return PyLong_FromSize_t(val->mv_size);
+}
+
+/**
+ * Narrow `val` to at most `length` bytes starting at `offset`, clamping both
+ * to the value like a Python slice, so only the requested part is copied.
+ */
+static void
+slice_val(MDB_val *val, size_t offset, size_t length)
+{
+    if(offset > val->mv_size) {
+        offset = val->mv_size;
+    }
+    if(length > (val->mv_size - offset)) {
+        length = val->mv_size - offset;
+    }
+    val->mv_data = ((char *) val->mv_data) + offset;
+    val->mv_size = length;
+}
+
+/**
+ * Set `dst` to a malloc()ed copy of `src`, returning -1 on failure.
+ */
+static int
+copy_val(MDB_val *dst, MDB_val *src)
 {
-    return PyBytes_FromStringAndSize(val->mv_data, val->mv_size);
+    if(! ((dst->mv_data = malloc(src->mv_size ? src->mv_size : 1)))) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(dst->mv_data, src->mv_data, src->mv_size);
+    dst->mv_size = src->mv_size;
+    return 0;
 }
 
 
@@ -427,41 +726,6 @@ val_from_buffer(MDB_val *val, PyObject *buf)
 }
 
 
-// -------------------
-// Concurrency control
-// -------------------
-
-static PyThreadState *save_thread(void)
-{
-    PyThreadState *s = NULL;
-    if(drop_gil) {
-        s = PyEval_SaveThread();
-    }
-    return s;
-}
-
-static void restore_thread(PyThreadState *state)
-{
-    if(drop_gil) {
-        PyEval_RestoreThread(state);
-    }
-}
-
-// Like Py_BEGIN_ALLOW_THREADS
-#define DROP_GIL \
-    { PyThreadState *_save; _save = save_thread();
-
-// Like Py_END_ALLOW_THREADS
-#define LOCK_GIL \
-    restore_thread(_save); }
-
-#define UNLOCKED(out, e) \
-    DROP_GIL \
-    out = (e); \
-    LOCK_GIL
-
-
-
 // ----------
 // Exceptions
 // ----------
@@ -653,210 +917,1767 @@ parse_args(int valid, int specsize, const struct argspec *argspec,
 }
 
 
-// --------------------------------------------------------
-// Functionality shared between Transaction and Environment
-// --------------------------------------------------------
-
-
-static PyObject *
-generic_get(int valid, MDB_txn *txn, DbObject *db, int buffers,
-            BUFFER_TYPE **bptr, PyObject *args, PyObject *kwds)
+#ifdef HAVE_FASTCALL
+/**
+ * Like parse_args() but for METH_FASTCALL|METH_KEYWORDS methods, so no
+ * argument tuple or keyword dict is built per call. Keyword names are almost
+ * always interned, so they are matched against the string table by identity
+ * before falling back to comparison.
+ */
+static int NOINLINE
+parse_args_fast(int valid, int specsize, const struct argspec *argspec,
+                PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                void *out)
 {
-    struct generic_get {
-        MDB_val key;
-        PyObject *default_;
-        DbObject *db;
-    } arg = {{0, 0}, Py_None, db};
-
-    static const struct argspec argspec[] = {
-        {ARG_BUF, KEY_S, OFFSET(generic_get, key)},
-        {ARG_OBJ, DEFAULT_S, OFFSET(generic_get, default_)},
-        {ARG_DB, DB_S, OFFSET(generic_get, db)}
-    };
-
-    if(parse_args(valid, SPECSIZE(), argspec, args, kwds, &arg)) {
-        return NULL;
+    if(! valid) {
+        err_invalid();
+        return -1;
     }
-
-    if(! arg.key.mv_data) {
-        return type_error("key must be given.");
+    if(nargs > specsize) {
+        type_error("too many positional arguments.");
+        return -1;
     }
 
-    MDB_val val;
-    int rc;
-    UNLOCKED(rc, mdb_get(txn, arg.db->dbi, &arg.key, &val));
-    if(rc) {
-        if(rc == MDB_NOTFOUND) {
-            Py_INCREF(arg.default_);
-            return arg.default_;
+    unsigned set = 0;
+    int i;
+    for(i = 0; i < nargs; i++) {
+        if(parse_arg(argspec + i, args[i], out)) {
+            return -1;
         }
-        return err_set("mdb_get", rc);
+        set |= 1 << i;
     }
-    if(buffers) {
-        return buffer_from_val(bptr, &val);
+
+    if(kwnames) {
+        Py_ssize_t size = PyTuple_GET_SIZE(kwnames);
+        Py_ssize_t c;
+        for(c = 0; c < size; c++) {
+            PyObject *kwd = PyTuple_GET_ITEM(kwnames, c);
+            for(i = 0; i < specsize; i++) {
+                if(string_tbl[argspec[i].string_id] == kwd) {
+                    break;
+                }
+            }
+            if(i == specsize) {
+                // Not interned, e.g. built with **{...} from a computed key.
+                for(i = 0; i < specsize; i++) {
+                    int rc = PyObject_RichCompareBool(
+                        string_tbl[argspec[i].string_id], kwd, Py_EQ);
+                    if(rc == -1) {
+                        return -1;
+                    } else if(rc) {
+                        break;
+                    }
+                }
+            }
+            if(i == specsize) {
+                type_error("unrecognized keyword argument");
+                return -1;
+            }
+            if(set & (1 << i)) {
+                PyErr_Format(PyExc_TypeError, "duplicate argument: %U", kwd);
+                return -1;
+            }
+            if(parse_arg(argspec + i, args[nargs + c], out)) {
+                return -1;
+            }
+            set |= 1 << i;
+        }
     }
-    return string_from_val(&val);
+    return 0;
 }
 
-static PyObject *
-generic_put(int valid, MDB_txn *txn, DbObject *db,
-            PyObject *args, PyObject *kwds)
-{
-    struct generic_put {
-        MDB_val key;
-        MDB_val value;
-        int dupdata;
-        int overwrite;
-        int append;
-        DbObject *db;
-    } arg = {{0, 0}, {0, 0}, 0, 1, 0, db};
-
-    static const struct argspec argspec[] = {
-        {ARG_BUF, KEY_S, OFFSET(generic_put, key)},
-        {ARG_BUF, VALUE_S, OFFSET(generic_put, value)},
-        {ARG_BOOL, DUPDATA_S, OFFSET(generic_put, dupdata)},
-        {ARG_BOOL, OVERWRITE_S, OFFSET(generic_put, overwrite)},
-        {ARG_BOOL, APPEND_S, OFFSET(generic_put, append)},
-        {ARG_DB, DB_S, OFFSET(generic_put, db)}
-    };
+// Declare, forward and parse arguments of methods registered with METH_FAST.
+#   define FAST_ARGS_DECL \
+        PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames
+#   define FAST_ARGS args, nargs, kwnames
+#   define PARSE_FAST_ARGS(valid, out) \
+        parse_args_fast(valid, SPECSIZE(), argspec, args, nargs, kwnames, out)
+#   define METH_FAST (METH_FASTCALL|METH_KEYWORDS)
+#else
+#   define FAST_ARGS_DECL PyObject *args, PyObject *kwds
+#   define FAST_ARGS args, kwds
+#   define PARSE_FAST_ARGS(valid, out) \
+        parse_args(valid, SPECSIZE(), argspec, args, kwds, out)
+#   define METH_FAST (METH_VARARGS|METH_KEYWORDS)
+#endif
 
-    if(parse_args(valid, SPECSIZE(), argspec, args, kwds, &arg)) {
-        return NULL;
-    }
 
-    int flags = 0;
-    if(! arg.dupdata) {
-        flags |= MDB_NODUPDATA;
-    }
-    if(! arg.overwrite) {
-        flags |= MDB_NOOVERWRITE;
-    }
-    if(arg.append) {
-        flags |= MDB_APPEND;
-    }
+// -------
+// Buffers
+// -------
 
-    DEBUG("inserting '%.*s' (%d) -> '%.*s' (%d)",
-        (int)arg.key.mv_size, (char *)arg.key.mv_data,
-        (int)arg.key.mv_size,
-        (int)arg.value.mv_size, (char *)arg.value.mv_data,
-        (int)arg.value.mv_size)
+// Deallocated BufObjects kept for reuse, since one is created per returned key
+// or value.
+#define MAX_SPARE_BUFS 64
+static BufObject *spare_bufs[MAX_SPARE_BUFS];
+static int spare_buf_count;
 
-    int rc;
-    UNLOCKED(rc, mdb_put(txn, (arg.db)->dbi, &arg.key, &arg.value, flags));
-    if(rc) {
-        if(rc == MDB_KEYEXIST) {
-            Py_RETURN_FALSE;
-        }
-        return err_set("mdb_put", rc);
+/**
+ * Return a new buffer pointing at `val`, valid until `trans` ends.
+ */
+static PyObject *
+make_buf(TransObject *trans, MDB_val *val)
+{
+    BufObject *self;
+    if(spare_buf_count) {
+        self = spare_bufs[--spare_buf_count];
+        PyObject_Init((PyObject *) self, &PyBuf_Type);
+    } else if(! ((self = PyObject_New(BufObject, &PyBuf_Type)))) {
+        return NULL;
     }
-    Py_RETURN_TRUE;
+    OBJECT_INIT(self)
+    LINK_CHILD(trans, self)
+    self->trans = trans;
+    self->val = *val;
+    self->writable = 0;
+    self->owned = 0;
+    return (PyObject *) self;
 }
 
+/**
+ * Return a new buffer taking ownership of `blob`'s data, so it can be returned
+ * without copying. The buffer does not depend on any transaction.
+ */
 static PyObject *
-generic_delete(int valid, MDB_txn *txn, DbObject *db,
-               PyObject *args, PyObject *kwds)
+make_owned_buf(struct blob *blob)
 {
-    struct generic_delete {
-        MDB_val key;
-        MDB_val val;
-        DbObject *db;
-    } arg = {{0, 0}, {0, 0}, db};
-
-    static const struct argspec argspec[] = {
-        {ARG_BUF, KEY_S, OFFSET(generic_delete, key)},
-        {ARG_BUF, VALUE_S, OFFSET(generic_delete, val)},
+    BufObject *self;
+    if(spare_buf_count) {
+        self = spare_bufs[--spare_buf_count];
+        PyObject_Init((PyObject *) self, &PyBuf_Type);
+    } else if(! ((self = PyObject_New(BufObject, &PyBuf_Type)))) {
+        return NULL;
+    }
+    OBJECT_INIT(self)
+    self->trans = NULL;
+    self->val.mv_data = blob->data;
+    self->val.mv_size = blob->size;
+    self->writable = 0;
+    self->owned = 1;
+    blob->data = NULL;
+    blob->size = 0;
+    blob->cap = 0;
+    return (PyObject *) self;
+}
+
+static int
+buf_clear(BufObject *self)
+{
+    if(self->valid && self->owned) {
+        free(self->val.mv_data);
+        self->val.mv_data = NULL;
+        self->val.mv_size = 0;
+        self->valid = 0;
+    } else if(self->valid) {
+        UNLINK_CHILD(self->trans, self)
+        if(self->trans->reserved == self) {
+            self->trans->reserved = NULL;
+        }
+        self->trans = NULL;
+        self->val.mv_data = NULL;
+        self->val.mv_size = 0;
+        self->valid = 0;
+    }
+    return 0;
+}
+
+static void
+buf_dealloc(BufObject *self)
+{
+    buf_clear(self);
+    if(spare_buf_count < MAX_SPARE_BUFS) {
+        spare_bufs[spare_buf_count++] = self;
+    } else {
+        PyObject_Del(self);
+    }
+}
+
+static int
+buf_getbuffer(BufObject *self, Py_buffer *view, int flags)
+{
+    if(! self->valid) {
+        view->obj = NULL;
+        err_invalid();
+        return -1;
+    }
+    return PyBuffer_FillInfo(view, (PyObject *) self, self->val.mv_data,
+                             self->val.mv_size, ! self->writable, flags);
+}
+
+/**
+ * Support `buf[i] = n` and `buf[i:j] = data` on buffers returned by
+ * Transaction.reserve(). Slice assignment cannot change the length.
+ */
+static int
+buf_ass_subscript(BufObject *self, PyObject *key, PyObject *value)
+{
+    if(! self->writable) {
+        type_error("buffer is read-only");
+        return -1;
+    }
+    if(! value) {
+        type_error("cannot delete from buffer");
+        return -1;
+    }
+
+    Py_ssize_t start, stop, step, len;
+    if(PyIndex_Check(key)) {
+        start = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if(start == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if(start < 0) {
+            start += self->val.mv_size;
+        }
+        if(start < 0 || (size_t) start >= self->val.mv_size) {
+            PyErr_SetString(PyExc_IndexError, "buffer index out of range");
+            return -1;
+        }
+        Py_ssize_t n = PyNumber_AsSsize_t(value, PyExc_ValueError);
+        if(n == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if(n < 0 || n > 255) {
+            PyErr_SetString(PyExc_ValueError, "byte must be in range(0, 256)");
+            return -1;
+        }
+        ((unsigned char *) self->val.mv_data)[start] = n;
+        return 0;
+    }
+    if(! PySlice_Check(key)) {
+        type_error("buffer indices must be integers or slices");
+        return -1;
+    }
+    if(PySlice_GetIndicesEx((void *) key, self->val.mv_size,
+                            &start, &stop, &step, &len)) {
+        return -1;
+    }
+    if(step != 1) {
+        type_error("extended slice assignment not supported");
+        return -1;
+    }
+
+    MDB_val src;
+    if(val_from_buffer(&src, value)) {
+        return -1;
+    }
+    if(src.mv_size != (size_t) len) {
+        PyErr_SetString(PyExc_ValueError,
+                        "slice assignment cannot resize buffer");
+        return -1;
+    }
+    memcpy(((char *) self->val.mv_data) + start, src.mv_data, len);
+    return 0;
+}
+
+static Py_ssize_t
+buf_length(BufObject *self)
+{
+    return self->val.mv_size;
+}
+
+static PyObject *
+buf_item(BufObject *self, Py_ssize_t i)
+{
+    if(i < 0 || (size_t) i >= self->val.mv_size) {
+        PyErr_SetString(PyExc_IndexError, "buffer index out of range");
+        return NULL;
+    }
+    unsigned char *p = self->val.mv_data;
+#if PY_MAJOR_VERSION >= 3
+    return PyLong_FromLong(p[i]);
+#else
+    return PyBytes_FromStringAndSize((char *) p + i, 1);
+#endif
+}
+
+/**
+ * Indexing returns a single byte, slicing returns a copy. To slice without
+ * copying, use memoryview() (or buffer() on Python 2).
+ */
+static PyObject *
+buf_subscript(BufObject *self, PyObject *key)
+{
+    if(PyIndex_Check(key)) {
+        Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if(i == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if(i < 0) {
+            i += self->val.mv_size;
+        }
+        return buf_item(self, i);
+    }
+    if(! PySlice_Check(key)) {
+        return type_error("buffer indices must be integers or slices");
+    }
+
+    Py_ssize_t start, stop, step, len;
+    if(PySlice_GetIndicesEx((void *) key, self->val.mv_size,
+                            &start, &stop, &step, &len)) {
+        return NULL;
+    }
+    char *p = self->val.mv_data;
+    if(step == 1) {
+        return PyBytes_FromStringAndSize(p + start, len);
+    }
+    PyObject *out = PyBytes_FromStringAndSize(NULL, len);
+    if(out) {
+        char *dst = PyBytes_AS_STRING(out);
+        Py_ssize_t i;
+        for(i = 0; i < len; i++) {
+            dst[i] = p[start + (i * step)];
+        }
+    }
+    return out;
+}
+
+/**
+ * Buffers compare equal to any object exporting the same bytes, like
+ * memoryview.
+ */
+static PyObject *
+buf_richcompare(BufObject *self, PyObject *other, int op)
+{
+    if((op != Py_EQ && op != Py_NE) || ! PyObject_CheckBuffer(other)) {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+    Py_buffer view;
+    if(PyObject_GetBuffer(other, &view, PyBUF_SIMPLE)) {
+        return NULL;
+    }
+    int eq = ((size_t) view.len == self->val.mv_size) &&
+        ! memcmp(view.buf, self->val.mv_data, view.len);
+    PyBuffer_Release(&view);
+    PyObject *ret = (eq == (op == Py_EQ)) ? Py_True : Py_False;
+    Py_INCREF(ret);
+    return ret;
+}
+
+static long
+buf_hash(BufObject *self)
+{
+    PyObject *s = PyBytes_FromStringAndSize(self->val.mv_data,
+                                            self->val.mv_size);
+    if(! s) {
+        return -1;
+    }
+    long hash = PyObject_Hash(s);
+    Py_DECREF(s);
+    return hash;
+}
+
+#if PY_MAJOR_VERSION < 3
+static PyObject *
+buf_str(BufObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    return PyBytes_FromStringAndSize(self->val.mv_data, self->val.mv_size);
+}
+
+static Py_ssize_t
+buf_getreadbuf(BufObject *self, Py_ssize_t segment, void **ptr)
+{
+    if(segment) {
+        PyErr_SetString(PyExc_SystemError, "invalid buffer segment");
+        return -1;
+    }
+    if(! self->valid) {
+        err_invalid();
+        return -1;
+    }
+    *ptr = self->val.mv_data;
+    return self->val.mv_size;
+}
+
+static Py_ssize_t
+buf_getwritebuf(BufObject *self, Py_ssize_t segment, void **ptr)
+{
+    if(! self->writable) {
+        type_error("buffer is read-only");
+        return -1;
+    }
+    return buf_getreadbuf(self, segment, ptr);
+}
+
+static Py_ssize_t
+buf_getsegcount(BufObject *self, Py_ssize_t *lenp)
+{
+    if(lenp) {
+        *lenp = self->val.mv_size;
+    }
+    return 1;
+}
+#endif
+
+static PySequenceMethods buf_as_sequence = {
+    .sq_length = (lenfunc) buf_length,
+    .sq_item = (ssizeargfunc) buf_item
+};
+
+static PyMappingMethods buf_as_mapping = {
+    .mp_length = (lenfunc) buf_length,
+    .mp_subscript = (binaryfunc) buf_subscript,
+    .mp_ass_subscript = (objobjargproc) buf_ass_subscript
+};
+
+static PyBufferProcs buf_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    .bf_getreadbuffer = (readbufferproc) buf_getreadbuf,
+    .bf_getwritebuffer = (writebufferproc) buf_getwritebuf,
+    .bf_getsegcount = (segcountproc) buf_getsegcount,
+    .bf_getcharbuffer = (charbufferproc) buf_getreadbuf,
+#endif
+    .bf_getbuffer = (getbufferproc) buf_getbuffer
+};
+
+PyTypeObject PyBuf_Type = {
+    PyObject_HEAD_INIT(0)
+    .tp_basicsize = sizeof(BufObject),
+    .tp_dealloc = (destructor) buf_dealloc,
+    .tp_clear = (inquiry) buf_clear,
+#if PY_MAJOR_VERSION >= 3
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+#else
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+    .tp_str = (reprfunc) buf_str,
+#endif
+    .tp_as_sequence = &buf_as_sequence,
+    .tp_as_mapping = &buf_as_mapping,
+    .tp_as_buffer = &buf_as_buffer,
+    .tp_richcompare = (richcmpfunc) buf_richcompare,
+    .tp_hash = (hashfunc) buf_hash,
+    .tp_name = "Buffer"
+};
+
+
+/**
+ * Invalidate any buffer returned by reserve(), since a write may move or
+ * split its page. Called before every write made through the transaction,
+ * and before a child transaction begins, since the child's copy of the page
+ * replaces the parent's when it commits.
+ */
+static void
+trans_end_reserve(TransObject *self)
+{
+    if(self->reserved) {
+        buf_clear(self->reserved);
+    }
+}
+
+
+// -------------
+// Value readers
+// -------------
+
+/**
+ * Return a new reader over `val`, valid until `trans` ends. If `sequential`
+ * is 1, the kernel is advised to read ahead aggressively over the value's
+ * pages.
+ */
+static PyObject *
+make_reader(TransObject *trans, MDB_val *val, int sequential)
+{
+    ReaderObject *self = PyObject_New(ReaderObject, &PyReader_Type);
+    if(! self) {
+        return NULL;
+    }
+    OBJECT_INIT(self)
+    LINK_CHILD(trans, self)
+    self->trans = trans;
+    Py_INCREF(trans);
+    self->val = *val;
+    self->pos = 0;
+
+#ifdef MADV_SEQUENTIAL
+    // Only read-only transactions are guaranteed to point into the map,
+    // rather than at a malloc()ed dirty page. The hint is best-effort.
+    if(sequential && (trans->flags & TRANS_RDONLY) && val->mv_size) {
+        uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t start = ((uintptr_t) val->mv_data) & ~(page - 1);
+        uintptr_t end = ((uintptr_t) val->mv_data) + val->mv_size;
+        madvise((void *) start, end - start, MADV_SEQUENTIAL);
+    }
+#endif
+    return (PyObject *) self;
+}
+
+static int
+reader_clear(ReaderObject *self)
+{
+    if(self->valid) {
+        UNLINK_CHILD(self->trans, self)
+        self->val.mv_data = NULL;
+        self->val.mv_size = 0;
+        self->valid = 0;
+    }
+    Py_CLEAR(self->trans);
+    return 0;
+}
+
+static void
+reader_dealloc(ReaderObject *self)
+{
+    reader_clear(self);
+    PyObject_Del(self);
+}
+
+/**
+ * Return the unread part of the value, limited to `size` bytes.
+ */
+static MDB_val
+reader_remaining(ReaderObject *self, size_t size)
+{
+    MDB_val val = self->val;
+    slice_val(&val, self->pos, size);
+    return val;
+}
+
+static PyObject *
+reader_close(ReaderObject *self)
+{
+    reader_clear(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+reader_closed(ReaderObject *self, void *closure)
+{
+    return PyBool_FromLong(! self->valid);
+}
+
+static PyObject *
+reader_true(ReaderObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+reader_false(ReaderObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    Py_RETURN_FALSE;
+}
+
+/**
+ * Reader.read(size=-1)
+ */
+static PyObject *
+reader_read(ReaderObject *self, PyObject *args)
+{
+    Py_ssize_t size = -1;
+    PyObject *size_obj = Py_None;
+    if(! PyArg_ParseTuple(args, "|O:read", &size_obj)) {
+        return NULL;
+    }
+    if(size_obj != Py_None) {
+        size = PyNumber_AsSsize_t(size_obj, PyExc_OverflowError);
+        if(size == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    if(! self->valid) {
+        return err_invalid();
+    }
+    MDB_val val = reader_remaining(self, size < 0 ? (size_t) -1 : size);
+    PyObject *s = string_from_val(self->trans->env, &val);
+    if(s) {
+        self->pos += val.mv_size;
+    }
+    return s;
+}
+
+static PyObject *
+reader_readall(ReaderObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    MDB_val val = reader_remaining(self, (size_t) -1);
+    PyObject *s = string_from_val(self->trans->env, &val);
+    if(s) {
+        self->pos += val.mv_size;
+    }
+    return s;
+}
+
+/**
+ * Reader.readinto(buffer) -> int
+ */
+static PyObject *
+reader_readinto(ReaderObject *self, PyObject *buffer)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    MDB_val val = reader_remaining(self, (size_t) -1);
+    Py_ssize_t n = copy_into_buffer(self->trans->env, &val, buffer, 0);
+    if(n == -1) {
+        return NULL;
+    }
+    self->pos += n;
+    return PyLong_FromSsize_t(n);
+}
+
+/**
+ * Reader.seek(offset, whence=0) -> int
+ */
+static PyObject *
+reader_seek(ReaderObject *self, PyObject *args)
+{
+    Py_ssize_t offset;
+    int whence = 0;
+    if(! PyArg_ParseTuple(args, "n|i:seek", &offset, &whence)) {
+        return NULL;
+    }
+    if(! self->valid) {
+        return err_invalid();
+    }
+
+    Py_ssize_t base;
+    switch(whence) {
+    case 0:
+        base = 0;
+        break;
+    case 1:
+        base = self->pos;
+        break;
+    case 2:
+        base = self->val.mv_size;
+        break;
+    default:
+        PyErr_Format(PyExc_ValueError, "invalid whence (%d)", whence);
+        return NULL;
+    }
+    if((base + offset) < 0) {
+        PyErr_SetString(PyExc_ValueError, "negative seek position");
+        return NULL;
+    }
+    // Like files, seeking past the end is allowed; reads there return b''.
+    self->pos = base + offset;
+    return PyLong_FromSize_t(self->pos);
+}
+
+static PyObject *
+reader_tell(ReaderObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    return PyLong_FromSize_t(self->pos);
+}
+
+static PyObject *
+reader_enter(ReaderObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *
+reader_exit(ReaderObject *self, PyObject *args)
+{
+    reader_clear(self);
+    Py_RETURN_NONE;
+}
+
+static Py_ssize_t
+reader_length(ReaderObject *self)
+{
+    return self->val.mv_size;
+}
+
+static struct PyMethodDef reader_methods[] = {
+    {"__enter__", (PyCFunction)reader_enter, METH_NOARGS},
+    {"__exit__", (PyCFunction)reader_exit, METH_VARARGS},
+    {"close", (PyCFunction)reader_close, METH_NOARGS},
+    {"read", (PyCFunction)reader_read, METH_VARARGS},
+    {"readable", (PyCFunction)reader_true, METH_NOARGS},
+    {"readall", (PyCFunction)reader_readall, METH_NOARGS},
+    {"readinto", (PyCFunction)reader_readinto, METH_O},
+    {"seek", (PyCFunction)reader_seek, METH_VARARGS},
+    {"seekable", (PyCFunction)reader_true, METH_NOARGS},
+    {"tell", (PyCFunction)reader_tell, METH_NOARGS},
+    {"writable", (PyCFunction)reader_false, METH_NOARGS},
+    {NULL, NULL}
+};
+
+static struct PyGetSetDef reader_getset[] = {
+    {"closed", (getter)reader_closed, NULL},
+    {NULL}
+};
+
+static PySequenceMethods reader_as_sequence = {
+    .sq_length = (lenfunc) reader_length
+};
+
+PyTypeObject PyReader_Type = {
+    PyObject_HEAD_INIT(0)
+    .tp_basicsize = sizeof(ReaderObject),
+    .tp_dealloc = (destructor) reader_dealloc,
+    .tp_clear = (inquiry) reader_clear,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_methods = reader_methods,
+    .tp_getset = reader_getset,
+    .tp_as_sequence = &reader_as_sequence,
+    .tp_name = "Reader"
+};
+
+
+// --------------------------------------------------------
+// Functionality shared between Transaction and Environment
+// --------------------------------------------------------
+
+
+static PyObject *
+generic_get(int valid, MDB_txn *txn, DbObject *db, TransObject *trans,
+            FAST_ARGS_DECL)
+{
+    struct generic_get {
+        MDB_val key;
+        PyObject *default_;
+        DbObject *db;
+    } arg = {{0, 0}, Py_None, db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(generic_get, key)},
+        {ARG_OBJ, DEFAULT_S, OFFSET(generic_get, default_)},
+        {ARG_DB, DB_S, OFFSET(generic_get, db)}
+    };
+
+    if(PARSE_FAST_ARGS(valid, &arg)) {
+        return NULL;
+    }
+
+    if(! arg.key.mv_data) {
+        return type_error("key must be given.");
+    }
+
+    MDB_val val;
+    int rc;
+    UNLOCKED(rc, arg.db->env, GIL_CHEAP,
+             mdb_get(txn, arg.db->dbi, &arg.key, &val));
+    if(rc) {
+        if(rc == MDB_NOTFOUND) {
+            Py_INCREF(arg.default_);
+            return arg.default_;
+        }
+        return err_set("mdb_get", rc);
+    }
+    if(trans && trans->buffers) {
+        return make_buf(trans, &val);
+    }
+    return string_from_val(arg.db->env, &val);
+}
+
+/**
+ * Merge sort `idx[0..count)` by the database order of the keys they index,
+ * using `tmp` as scratch space. Stable, so duplicate keys keep their order.
+ */
+static void
+sort_key_indices(MDB_txn *txn, MDB_dbi dbi, const MDB_val *keys,
+                 size_t *idx, size_t *tmp, size_t count)
+{
+    if(count < 2) {
+        return;
+    }
+
+    size_t half = count / 2;
+    sort_key_indices(txn, dbi, keys, idx, tmp, half);
+    sort_key_indices(txn, dbi, keys, idx + half, tmp, count - half);
+    if(mdb_cmp(txn, dbi, keys + idx[half - 1], keys + idx[half]) <= 0) {
+        return; // Already ordered, common for batches with locality.
+    }
+
+    size_t i = 0;
+    size_t j = half;
+    size_t k = 0;
+    while(i < half && j < count) {
+        if(mdb_cmp(txn, dbi, keys + idx[j], keys + idx[i]) < 0) {
+            tmp[k++] = idx[j++];
+        } else {
+            tmp[k++] = idx[i++];
+        }
+    }
+    while(i < half) {
+        tmp[k++] = idx[i++];
+    }
+    memcpy(idx, tmp, sizeof(size_t) * k);
+}
+
+/**
+ * Visit `keys` in database order using a single cursor, so consecutive
+ * lookups that land on the same or nearby leaf pages avoid a descent from the
+ * root. Found values are written to `vals` at the key's original index,
+ * missing keys have mv_size set to -1. Called without the GIL.
+ */
+static int
+cursor_multi_get(MDB_txn *txn, MDB_dbi dbi, const MDB_val *keys,
+                 MDB_val *vals, size_t count)
+{
+    size_t *idx = malloc(sizeof(size_t) * 2 * (count ? count : 1));
+    if(! idx) {
+        return ENOMEM;
+    }
+
+    size_t i;
+    for(i = 0; i < count; i++) {
+        idx[i] = i;
+    }
+    sort_key_indices(txn, dbi, keys, idx, idx + count, count);
+
+    MDB_cursor *curs = NULL;
+    int rc = mdb_cursor_open(txn, dbi, &curs);
+    for(i = 0; i < count && !rc; i++) {
+        MDB_val key = keys[idx[i]];
+        rc = mdb_cursor_get(curs, &key, vals + idx[i], MDB_SET_KEY);
+        if(rc == MDB_NOTFOUND) {
+            vals[idx[i]].mv_size = (size_t) -1;
+            rc = 0;
+        }
+    }
+    if(curs) {
+        mdb_cursor_close(curs);
+    }
+    free(idx);
+    return rc;
+}
+
+/**
+ * Look up every key in `keys` with the GIL released once for the whole batch.
+ * Returns a list of values aligned with `keys`, containing `default_` for
+ * missing keys, or if `as_dict` is true, a dict containing only the keys that
+ * were found. If `sort` is true, keys are visited in database order using
+ * cursor_multi_get().
+ */
+static PyObject *
+multi_get(MDB_txn *txn, DbObject *db, PyObject *keys, PyObject *default_,
+          int as_dict, int sort)
+{
+    PyObject *seq = PySequence_Fast(keys, "keys must be iterable.");
+    if(! seq) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    PyObject *ret = NULL;
+    Py_ssize_t i;
+
+    // Keys followed by values; the sequence keeps key buffers alive.
+    MDB_val *vals = malloc(sizeof(MDB_val) * 2 * (count ? count : 1));
+    if(! vals) {
+        PyErr_NoMemory();
+        goto out;
+    }
+    MDB_val *keyv = vals;
+    MDB_val *valv = vals + count;
+    for(i = 0; i < count; i++) {
+        if(val_from_buffer(keyv + i, items[i])) {
+            goto out;
+        }
+    }
+
+    int rc = 0;
+    DROP_GIL(db->env, GIL_SLOW)
+    if(sort) {
+        rc = cursor_multi_get(txn, db->dbi, keyv, valv, count);
+    } else {
+        for(i = 0; i < count; i++) {
+            rc = mdb_get(txn, db->dbi, keyv + i, valv + i);
+            if(rc == MDB_NOTFOUND) {
+                valv[i].mv_size = (size_t) -1;
+                rc = 0;
+            } else if(rc) {
+                break;
+            }
+        }
+    }
+    LOCK_GIL
+    if(rc) {
+        err_set(sort ? "mdb_cursor_get" : "mdb_get", rc);
+        goto out;
+    }
+
+    if(! ((ret = as_dict ? PyDict_New() : PyList_New(count)))) {
+        goto out;
+    }
+    for(i = 0; i < count; i++) {
+        PyObject *val;
+        if(valv[i].mv_size == (size_t) -1) {
+            if(as_dict) {
+                continue;
+            }
+            val = default_;
+            Py_INCREF(val);
+        } else if(! ((val = string_from_val(db->env, valv + i)))) {
+            Py_CLEAR(ret);
+            break;
+        }
+
+        if(! as_dict) {
+            PyList_SET_ITEM(ret, i, val);
+        } else {
+            rc = PyDict_SetItem(ret, items[i], val);
+            Py_DECREF(val);
+            if(rc) {
+                Py_CLEAR(ret);
+                break;
+            }
+        }
+    }
+
+out:
+    free(vals);
+    Py_DECREF(seq);
+    return ret;
+}
+
+static PyObject *
+generic_put(int valid, MDB_txn *txn, DbObject *db, FAST_ARGS_DECL)
+{
+    struct generic_put {
+        MDB_val key;
+        MDB_val value;
+        int dupdata;
+        int overwrite;
+        int append;
+        DbObject *db;
+    } arg = {{0, 0}, {0, 0}, 0, 1, 0, db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(generic_put, key)},
+        {ARG_BUF, VALUE_S, OFFSET(generic_put, value)},
+        {ARG_BOOL, DUPDATA_S, OFFSET(generic_put, dupdata)},
+        {ARG_BOOL, OVERWRITE_S, OFFSET(generic_put, overwrite)},
+        {ARG_BOOL, APPEND_S, OFFSET(generic_put, append)},
+        {ARG_DB, DB_S, OFFSET(generic_put, db)}
+    };
+
+    if(PARSE_FAST_ARGS(valid, &arg)) {
+        return NULL;
+    }
+
+    int flags = 0;
+    if(! arg.dupdata) {
+        flags |= MDB_NODUPDATA;
+    }
+    if(! arg.overwrite) {
+        flags |= MDB_NOOVERWRITE;
+    }
+    if(arg.append) {
+        flags |= MDB_APPEND;
+    }
+
+    DEBUG("inserting '%.*s' (%d) -> '%.*s' (%d)",
+        (int)arg.key.mv_size, (char *)arg.key.mv_data,
+        (int)arg.key.mv_size,
+        (int)arg.value.mv_size, (char *)arg.value.mv_data,
+        (int)arg.value.mv_size)
+
+    int rc;
+    UNLOCKED(rc, arg.db->env, LARGE_COST(arg.value.mv_size),
+             mdb_put(txn, (arg.db)->dbi, &arg.key, &arg.value, flags));
+    if(rc) {
+        if(rc == MDB_KEYEXIST) {
+            Py_RETURN_FALSE;
+        }
+        return err_set("mdb_put", rc);
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+generic_delete(int valid, MDB_txn *txn, DbObject *db, FAST_ARGS_DECL)
+{
+    struct generic_delete {
+        MDB_val key;
+        MDB_val val;
+        DbObject *db;
+    } arg = {{0, 0}, {0, 0}, db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(generic_delete, key)},
+        {ARG_BUF, VALUE_S, OFFSET(generic_delete, val)},
         {ARG_DB, DB_S, OFFSET(generic_delete, db)}
     };
 
-    if(parse_args(valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+    if(PARSE_FAST_ARGS(valid, &arg)) {
+        return NULL;
+    }
+    MDB_val *val_ptr = arg.val.mv_size ? &arg.val : NULL;
+    int rc;
+    UNLOCKED(rc, arg.db->env, GIL_CHEAP,
+             mdb_del(txn, arg.db->dbi, &arg.key, val_ptr));
+    if(rc) {
+        if(rc == MDB_NOTFOUND) {
+             Py_RETURN_FALSE;
+        }
+        return err_set("mdb_del", rc);
+    }
+    Py_RETURN_TRUE;
+}
+
+/**
+ * Start a top-level read-only MDB_txn, preferring to renew a reset one from
+ * the environment's spare list. Renewing skips a malloc(), the reader table
+ * mutex and the linear scan for a free reader slot.
+ */
+static int
+env_txn_begin(EnvObject *env, MDB_txn **txn)
+{
+    int rc;
+    while(env->spare_count) {
+        MDB_txn *spare = env->spare_txns[--env->spare_count];
+        UNLOCKED(rc, env, GIL_CHEAP, mdb_txn_renew(spare));
+        if(! rc) {
+            env->spare_hits++;
+            *txn = spare;
+            return 0;
+        }
+        DROP_GIL(env, GIL_CHEAP)
+        mdb_txn_abort(spare);
+        LOCK_GIL
+    }
+
+    env->spare_misses++;
+    UNLOCKED(rc, env, GIL_CHEAP,
+             mdb_txn_begin(env->env, NULL, MDB_RDONLY, txn));
+    return rc;
+}
+
+/**
+ * Finish a MDB_txn started by env_txn_begin(). If the spare list has room the
+ * transaction is reset and kept, retaining its reader slot, otherwise it is
+ * aborted.
+ */
+static void
+env_txn_release(EnvObject *env, MDB_txn *txn)
+{
+    if(env->spare_count < env->max_spare_txns) {
+        mdb_txn_reset(txn);
+        env->spare_txns[env->spare_count++] = txn;
+    } else {
+        DROP_GIL(env, GIL_CHEAP)
+        mdb_txn_abort(txn);
+        LOCK_GIL
+    }
+}
+
+/**
+ * Abort any spare transactions and free the spare list. Must be called before
+ * mdb_env_close().
+ */
+static void
+env_clear_spares(EnvObject *env)
+{
+    while(env->spare_count) {
+        MDB_txn *spare = env->spare_txns[--env->spare_count];
+        DROP_GIL(env, GIL_CHEAP)
+        mdb_txn_abort(spare);
+        LOCK_GIL
+    }
+    free(env->spare_txns);
+    env->spare_txns = NULL;
+    env->max_spare_txns = 0;
+}
+
+static uint64_t
+monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static void
+snapshot_unlink(struct snapshot *snap)
+{
+    if(snap->prev) {
+        snap->prev->next = snap->next;
+    } else if(snap->env) {
+        snap->env->snapshots = snap->next;
+    }
+    if(snap->next) {
+        snap->next->prev = snap->prev;
+    }
+    snap->prev = NULL;
+    snap->next = NULL;
+}
+
+/**
+ * Capsule destructor, invoked when the owning thread's state dict is cleared.
+ */
+static void
+snapshot_destroy(PyObject *capsule)
+{
+    struct snapshot *snap = PyCapsule_GetPointer(capsule, NULL);
+    if(snap->env) {
+        if(snap->txn) {
+            env_txn_release(snap->env, snap->txn);
+        }
+        snapshot_unlink(snap);
+    }
+    free(snap);
+}
+
+/**
+ * Abort every thread's snapshot and detach them from the environment. Must be
+ * called before mdb_env_close().
+ */
+static void
+env_clear_snapshots(EnvObject *env)
+{
+    while(env->snapshots) {
+        struct snapshot *snap = env->snapshots;
+        if(snap->txn) {
+            DROP_GIL(env, GIL_CHEAP)
+            mdb_txn_abort(snap->txn);
+            LOCK_GIL
+            snap->txn = NULL;
+        }
+        snapshot_unlink(snap);
+        snap->env = NULL;
+    }
+}
+
+/**
+ * Return the calling thread's read snapshot, starting a new one if none
+ * exists, or if a transaction has committed since it was started and it is
+ * older than max_staleness milliseconds. The transaction remains owned by the
+ * snapshot and must not be released by the caller.
+ */
+static MDB_txn *
+env_snapshot_txn(EnvObject *env)
+{
+    PyObject *dict = PyThreadState_GetDict();
+    if(! dict) {
+        type_error("no thread state available.");
         return NULL;
     }
-    MDB_val *val_ptr = arg.val.mv_size ? &arg.val : NULL;
+
+    struct snapshot *snap;
+    PyObject *capsule = PyDict_GetItem(dict, env->snap_key);
+    if(capsule) {
+        snap = PyCapsule_GetPointer(capsule, NULL);
+    } else {
+        if(! ((snap = calloc(1, sizeof *snap)))) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        if(! ((capsule = PyCapsule_New(snap, NULL, snapshot_destroy)))) {
+            free(snap);
+            return NULL;
+        }
+        int rc = PyDict_SetItem(dict, env->snap_key, capsule);
+        Py_DECREF(capsule);
+        if(rc) {
+            return NULL;
+        }
+    }
+
+    // Key is the env's address, so it may belong to a closed predecessor.
+    if(snap->env != env) {
+        snap->env = env;
+        snap->prev = NULL;
+        snap->next = env->snapshots;
+        if(snap->next) {
+            snap->next->prev = snap;
+        }
+        env->snapshots = snap;
+    }
+
+    MDB_envinfo info;
+    mdb_env_info(env->env, &info);
+    if(snap->txn) {
+        if(info.me_last_txnid == snap->txnid ||
+           (env->max_staleness &&
+            (monotonic_ms() - snap->started) < (uint64_t) env->max_staleness)) {
+            env->snap_hits++;
+            return snap->txn;
+        }
+        env_txn_release(env, snap->txn);
+        snap->txn = NULL;
+    }
+
+    env->snap_misses++;
+    int rc = env_txn_begin(env, &snap->txn);
+    if(rc) {
+        snap->txn = NULL;
+        return err_set("mdb_txn_begin", rc);
+    }
+    snap->txnid = info.me_last_txnid;
+    snap->started = monotonic_ms();
+    return snap->txn;
+}
+
+static PyObject *
+make_trans(EnvObject *env, TransObject *parent, int write, int buffers)
+{
+    DEBUG("make_trans(env=%p, parent=%p, write=%d, buffers=%d)",
+        env, parent, write, buffers)
+    if(! env->valid) {
+        return err_invalid();
+    }
+
+    MDB_txn *parent_txn = NULL;
+    if(parent) {
+        if(! parent->valid) {
+            return err_invalid();
+        }
+        trans_end_reserve(parent);
+        parent_txn = parent->txn;
+    }
+
+    if(write && env->readonly) {
+        return err_set("Cannot start write transaction with read-only env", 0);
+    }
+
+    TransObject *self = PyObject_New(TransObject, &PyTransaction_Type);
+    if(! self) {
+        return NULL;
+    }
+
     int rc;
-    UNLOCKED(rc, mdb_del(txn, arg.db->dbi, &arg.key, val_ptr));
+    if(write && !env->readonly) {
+        self->flags = 0;
+        UNLOCKED(rc, env, GIL_SLOW,
+                 mdb_txn_begin(env->env, parent_txn, 0, &self->txn));
+    } else if(parent_txn) {
+        self->flags = TRANS_RDONLY;
+        UNLOCKED(rc, env, GIL_CHEAP,
+                 mdb_txn_begin(env->env, parent_txn, MDB_RDONLY,
+                               &self->txn));
+    } else {
+        self->flags = TRANS_RDONLY | TRANS_SPARE;
+        rc = env_txn_begin(env, &self->txn);
+    }
     if(rc) {
-        if(rc == MDB_NOTFOUND) {
-             Py_RETURN_FALSE;
+        PyObject_Del(self);
+        return err_set("mdb_txn_begin", rc);
+    }
+
+    OBJECT_INIT(self)
+    LINK_CHILD(env, self)
+    self->env = env;
+    Py_INCREF(env);
+    self->buffers = buffers;
+    self->reserved = NULL;
+    return (PyObject *)self;
+}
+
+static PyObject *
+make_cursor(DbObject *db, TransObject *trans)
+{
+    if(! trans->valid) {
+        return err_invalid();
+    }
+    if(! db) {
+        db = trans->env->main_db;
+    }
+
+    CursorObject *self = PyObject_New(CursorObject, &PyCursor_Type);
+    int rc;
+    UNLOCKED(rc, trans->env, GIL_CHEAP,
+             mdb_cursor_open(trans->txn, db->dbi, &self->curs));
+    if(rc) {
+        PyObject_Del(self);
+        return err_set("mdb_cursor_open", rc);
+    }
+
+    DEBUG("sizeof cursor = %d", (int) sizeof *self)
+    OBJECT_INIT(self)
+    LINK_CHILD(trans, self)
+    self->positioned = 0;
+    self->key.mv_size = 0;
+    self->val.mv_size = 0;
+    self->val_stale = 0;
+    self->trans = trans;
+    Py_INCREF(self->trans);
+    return (PyObject *) self;
+}
+
+// ------------
+// Write batches
+// ------------
+
+enum batch_op_type {
+    BATCH_PUT,
+    BATCH_DELETE
+};
+
+// Operation recorded by a WriteBatch. Keys and values are offsets into the
+// batch's data blob, since it may be moved by realloc().
+struct batch_op {
+    int type;
+    int db; // Index into BatchObject.dbs, or -1 for the main database.
+    unsigned int flags; // mdb_put() flags.
+    size_t key_off;
+    size_t key_size;
+    size_t val_off;
+    size_t val_size; // 0 deletes every value of a DUPSORT key.
+};
+
+// Operations accumulated without a transaction, then applied by
+// Environment.write() in a single write transaction.
+typedef struct {
+    PyObject_HEAD
+    struct blob ops; // Array of struct batch_op.
+    struct blob data; // Copied keys and values.
+    PyObject *dbs; // List of DbObjects referenced by ops.
+    int busy; // Being applied by Environment.write() without the GIL.
+} BatchObject;
+
+static PyObject *
+batch_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    if(parse_args(1, 0, NULL, args, kwds, NULL)) {
+        return NULL;
+    }
+    BatchObject *self = PyObject_New(BatchObject, type);
+    if(! self) {
+        return NULL;
+    }
+    memset(&self->ops, 0, sizeof self->ops);
+    memset(&self->data, 0, sizeof self->data);
+    self->busy = 0;
+    if(! ((self->dbs = PyList_New(0)))) {
+        PyObject_Del(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static void
+batch_dealloc(BatchObject *self)
+{
+    free(self->ops.data);
+    free(self->data.data);
+    Py_CLEAR(self->dbs);
+    PyObject_Del(self);
+}
+
+static Py_ssize_t
+batch_length(BatchObject *self)
+{
+    return self->ops.size / sizeof(struct batch_op);
+}
+
+/**
+ * Copy `key` and `val` into the batch and record an operation on them.
+ * Returns -1 on error.
+ */
+static int
+batch_append(BatchObject *self, int type, DbObject *db, unsigned int flags,
+             MDB_val *key, MDB_val *val)
+{
+    if(self->busy) {
+        err_set("WriteBatch", EBUSY);
+        return -1;
+    }
+    struct batch_op op = {type, -1, flags};
+    if(db) {
+        Py_ssize_t len = PyList_GET_SIZE(self->dbs);
+        for(op.db = 0; op.db < len; op.db++) {
+            if(PyList_GET_ITEM(self->dbs, op.db) == (PyObject *) db) {
+                break;
+            }
+        }
+        if(op.db == len && PyList_Append(self->dbs, (PyObject *) db)) {
+            return -1;
+        }
+    }
+
+    size_t size = self->data.size;
+    op.key_off = self->data.size;
+    op.key_size = key->mv_size;
+    op.val_off = op.key_off + key->mv_size;
+    op.val_size = val->mv_size;
+    if(blob_append(&self->data, key->mv_data, key->mv_size) ||
+       blob_append(&self->data, val->mv_data, val->mv_size) ||
+       blob_append(&self->ops, &op, sizeof op)) {
+        self->data.size = size;
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * WriteBatch.put(key, value, dupdata=False, overwrite=True, append=False,
+ *                db=None)
+ */
+static PyObject *
+batch_put(BatchObject *self, PyObject *args, PyObject *kwds)
+{
+    struct batch_put {
+        MDB_val key;
+        MDB_val value;
+        int dupdata;
+        int overwrite;
+        int append;
+        DbObject *db;
+    } arg = {{0, 0}, {0, 0}, 0, 1, 0, NULL};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(batch_put, key)},
+        {ARG_BUF, VALUE_S, OFFSET(batch_put, value)},
+        {ARG_BOOL, DUPDATA_S, OFFSET(batch_put, dupdata)},
+        {ARG_BOOL, OVERWRITE_S, OFFSET(batch_put, overwrite)},
+        {ARG_BOOL, APPEND_S, OFFSET(batch_put, append)},
+        {ARG_DB, DB_S, OFFSET(batch_put, db)}
+    };
+
+    if(parse_args(1, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! (arg.key.mv_data && arg.value.mv_data)) {
+        return type_error("key and value must be given.");
+    }
+
+    unsigned int flags = 0;
+    if(! arg.dupdata) {
+        flags |= MDB_NODUPDATA;
+    }
+    if(! arg.overwrite) {
+        flags |= MDB_NOOVERWRITE;
+    }
+    if(arg.append) {
+        flags |= MDB_APPEND;
+    }
+    if(batch_append(self, BATCH_PUT, arg.db, flags, &arg.key, &arg.value)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * WriteBatch.delete(key, value='', db=None)
+ */
+static PyObject *
+batch_delete(BatchObject *self, PyObject *args, PyObject *kwds)
+{
+    struct batch_delete {
+        MDB_val key;
+        MDB_val value;
+        DbObject *db;
+    } arg = {{0, 0}, {0, 0}, NULL};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(batch_delete, key)},
+        {ARG_BUF, VALUE_S, OFFSET(batch_delete, value)},
+        {ARG_DB, DB_S, OFFSET(batch_delete, db)}
+    };
+
+    if(parse_args(1, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! arg.key.mv_data) {
+        return type_error("key must be given.");
+    }
+    if(batch_append(self, BATCH_DELETE, arg.db, 0, &arg.key, &arg.value)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+batch_clear(BatchObject *self)
+{
+    if(self->busy) {
+        return err_set("WriteBatch", EBUSY);
+    }
+    self->ops.size = 0;
+    self->data.size = 0;
+    if(PyList_SetSlice(self->dbs, 0, PyList_GET_SIZE(self->dbs), NULL)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * A WriteBatch being applied by Environment.write(), see batch_apply().
+ */
+struct batch_ctx {
+    MDB_txn *txn; // Read transaction used by batch_cmp().
+    struct batch_op *ops;
+    char *data;
+    MDB_dbi main_dbi;
+    MDB_dbi *dbis; // DBI of each entry in BatchObject.dbs.
+    size_t n;
+    size_t *idx; // Scratch for sorting 2*n indices, or NULL if unsorted.
+    char *results; // results[i] is 1 if op i stored or deleted a record.
+    int rc;
+    const char *what; // Name of the MDB call that failed.
+
+    // Group commit queue, see group_write().
+    struct batch_ctx *next;
+    int done;
+};
+
+static MDB_dbi
+batch_dbi(struct batch_ctx *ctx, struct batch_op *op)
+{
+    return (op->db == -1) ? ctx->main_dbi : ctx->dbis[op->db];
+}
+
+/**
+ * Order ops by database, then key using the database's comparison function.
+ */
+static int
+batch_cmp(struct batch_ctx *ctx, size_t a, size_t b)
+{
+    struct batch_op *x = ctx->ops + a;
+    struct batch_op *y = ctx->ops + b;
+    MDB_dbi dbi = batch_dbi(ctx, x);
+    MDB_dbi dbi2 = batch_dbi(ctx, y);
+    if(dbi != dbi2) {
+        return (dbi < dbi2) ? -1 : 1;
+    }
+    MDB_val k1 = {x->key_size, ctx->data + x->key_off};
+    MDB_val k2 = {y->key_size, ctx->data + y->key_off};
+    return mdb_cmp(ctx->txn, dbi, &k1, &k2);
+}
+
+/**
+ * Merge sort the `n` op indices in `idx` using `tmp` as scratch space. The
+ * sort is stable, so operations on the same key still apply in the order
+ * they were recorded.
+ */
+static void
+batch_sort(struct batch_ctx *ctx, size_t *idx, size_t *tmp, size_t n)
+{
+    if(n < 2) {
+        return;
+    }
+    size_t half = n / 2;
+    batch_sort(ctx, idx, tmp, half);
+    batch_sort(ctx, idx + half, tmp, n - half);
+
+    size_t i = 0;
+    size_t j = half;
+    size_t k = 0;
+    while(i < half && j < n) {
+        if(batch_cmp(ctx, idx[j], idx[i]) < 0) {
+            tmp[k++] = idx[j++];
+        } else {
+            tmp[k++] = idx[i++];
         }
-        return err_set("mdb_del", rc);
     }
-    Py_RETURN_TRUE;
+    while(i < half) {
+        tmp[k++] = idx[i++];
+    }
+    while(j < n) {
+        tmp[k++] = idx[j++];
+    }
+    memcpy(idx, tmp, sizeof *idx * n);
 }
 
-static PyObject *
-make_trans(EnvObject *env, TransObject *parent, int write, int buffers)
+/**
+ * Sort the batch's ops by key into ctx->idx. The comparison functions are
+ * read from a short read transaction, so that the sort happens before the
+ * write lock is taken rather than inside the write transaction (or a group
+ * leader's). Called without the GIL. Returns the MDB error code, also stored
+ * in ctx->rc with the failed call in ctx->what.
+ */
+static int
+batch_sort_ops(EnvObject *env, struct batch_ctx *ctx)
 {
-    DEBUG("make_trans(env=%p, parent=%p, write=%d, buffers=%d)",
-        env, parent, write, buffers)
-    if(! env->valid) {
-        return err_invalid();
+    size_t i;
+    ctx->what = "mdb_txn_begin";
+    if((ctx->rc = mdb_txn_begin(env->env, NULL, MDB_RDONLY, &ctx->txn))) {
+        return ctx->rc;
     }
+    for(i = 0; i < ctx->n; i++) {
+        ctx->idx[i] = i;
+    }
+    batch_sort(ctx, ctx->idx, ctx->idx + ctx->n, ctx->n);
+    mdb_txn_abort(ctx->txn);
+    ctx->txn = NULL;
+    return 0;
+}
 
-    MDB_txn *parent_txn = NULL;
-    if(parent) {
-        if(! parent->valid) {
-            return err_invalid();
+/**
+ * Apply the batch's ops to `txn`, in the order of ctx->idx if it is set.
+ * Called without the GIL. Returns the MDB error code, also stored in ctx->rc
+ * with the failed call in ctx->what.
+ */
+static int
+batch_apply(struct batch_ctx *ctx, MDB_txn *txn)
+{
+    size_t *idx = ctx->idx;
+    size_t i;
+    int rc = 0;
+    for(i = 0; i < ctx->n && ! rc; i++) {
+        size_t j = idx ? idx[i] : i;
+        struct batch_op *op = ctx->ops + j;
+        MDB_dbi dbi = batch_dbi(ctx, op);
+        MDB_val key = {op->key_size, ctx->data + op->key_off};
+        MDB_val val = {op->val_size, ctx->data + op->val_off};
+        if(op->type == BATCH_PUT) {
+            ctx->what = "mdb_put";
+            rc = mdb_put(txn, dbi, &key, &val, op->flags);
+            ctx->results[j] = rc != MDB_KEYEXIST;
+            if(rc == MDB_KEYEXIST) {
+                rc = 0;
+            }
+        } else {
+            ctx->what = "mdb_del";
+            rc = mdb_del(txn, dbi, &key, val.mv_size ? &val : NULL);
+            ctx->results[j] = rc != MDB_NOTFOUND;
+            if(rc == MDB_NOTFOUND) {
+                rc = 0;
+            }
         }
-        parent_txn = parent->txn;
     }
+    return ctx->rc = rc;
+}
 
-    if(write && env->readonly) {
-        return err_set("Cannot start write transaction with read-only env", 0);
+/**
+ * Apply `ctx` in a transaction of its own. Called without the GIL.
+ */
+static void
+batch_write(EnvObject *env, struct batch_ctx *ctx)
+{
+    MDB_txn *txn;
+    ctx->what = "mdb_txn_begin";
+    if((ctx->rc = mdb_txn_begin(env->env, NULL, 0, &txn))) {
+        return;
     }
-
-    TransObject *self = PyObject_New(TransObject, &PyTransaction_Type);
-    if(! self) {
-        return NULL;
+    if(batch_apply(ctx, txn)) {
+        mdb_txn_abort(txn);
+    } else {
+        ctx->what = "mdb_txn_commit";
+        ctx->rc = mdb_txn_commit(txn);
     }
+}
 
-    int flags = (write && !env->readonly) ? 0 : MDB_RDONLY;
-    int rc;
-    UNLOCKED(rc, mdb_txn_begin(env->env, parent_txn, flags, &self->txn));
-    if(rc) {
-        PyObject_Del(self);
-        return err_set("mdb_txn_begin", rc);
+/**
+ * Apply a group of queued requests in one transaction, so they share a single
+ * commit and sync. When there are several, each is applied in a nested
+ * transaction, so a request that fails is rolled back without affecting the
+ * others. MDB_WRITEMAP does not support nested transactions, so there each
+ * request is committed separately. Called without the GIL.
+ */
+static void
+group_commit(EnvObject *env, struct batch_ctx *reqs)
+{
+    struct batch_ctx *ctx;
+    unsigned int flags = 0;
+    mdb_env_get_flags(env->env, &flags);
+    if(! reqs->next || (flags & MDB_WRITEMAP)) {
+        for(ctx = reqs; ctx; ctx = ctx->next) {
+            batch_write(env, ctx);
+            env->group_commits++;
+            env->group_writes++;
+        }
+        return;
     }
 
-    OBJECT_INIT(self)
-    LINK_CHILD(env, self)
-    self->env = env;
-    Py_INCREF(env);
-    self->buffers = buffers;
-    self->key_buf = NULL;
-    return (PyObject *)self;
+    MDB_txn *txn;
+    const char *what = "mdb_txn_begin";
+    int rc = mdb_txn_begin(env->env, NULL, 0, &txn);
+    if(! rc) {
+        for(ctx = reqs; ctx; ctx = ctx->next) {
+            MDB_txn *child;
+            ctx->what = "mdb_txn_begin";
+            if((ctx->rc = mdb_txn_begin(env->env, txn, 0, &child))) {
+                continue;
+            }
+            if(batch_apply(ctx, child)) {
+                mdb_txn_abort(child);
+            } else {
+                ctx->what = "mdb_txn_commit";
+                ctx->rc = mdb_txn_commit(child);
+            }
+            env->group_writes++;
+        }
+        what = "mdb_txn_commit";
+        rc = mdb_txn_commit(txn);
+        env->group_commits++;
+    }
+    // Requests that succeeded alone still fail if the group does.
+    for(ctx = reqs; ctx; ctx = ctx->next) {
+        if(rc && ! ctx->rc) {
+            ctx->rc = rc;
+            ctx->what = what;
+        }
+    }
 }
 
-static PyObject *
-make_cursor(DbObject *db, TransObject *trans)
+/**
+ * Queue `ctx` for a group commit and wait until it has been applied. The first
+ * writer to find no commit in progress becomes the leader: it takes every
+ * queued request and commits them together, while writers arriving meanwhile
+ * queue up for the next group. Called without the GIL.
+ */
+static void
+group_write(EnvObject *env, struct batch_ctx *ctx)
 {
-    if(! trans->valid) {
-        return err_invalid();
-    }
-    if(! db) {
-        db = trans->env->main_db;
+    pthread_mutex_lock(&env->group_lock);
+    ctx->next = NULL;
+    ctx->done = 0;
+    *env->group_tail = ctx;
+    env->group_tail = &ctx->next;
+
+    while(! ctx->done) {
+        if(env->group_busy) {
+            pthread_cond_wait(&env->group_cond, &env->group_lock);
+            continue;
+        }
+        struct batch_ctx *reqs = env->group_head;
+        env->group_head = NULL;
+        env->group_tail = &env->group_head;
+        env->group_busy = 1;
+        pthread_mutex_unlock(&env->group_lock);
+
+        group_commit(env, reqs);
+
+        pthread_mutex_lock(&env->group_lock);
+        env->group_busy = 0;
+        while(reqs) {
+            struct batch_ctx *next = reqs->next;
+            reqs->done = 1;
+            reqs = next;
+        }
+        pthread_cond_broadcast(&env->group_cond);
     }
+    pthread_mutex_unlock(&env->group_lock);
+}
 
-    CursorObject *self = PyObject_New(CursorObject, &PyCursor_Type);
-    int rc;
-    UNLOCKED(rc, mdb_cursor_open(trans->txn, db->dbi, &self->curs));
-    if(rc) {
-        PyObject_Del(self);
-        return err_set("mdb_cursor_open", rc);
-    }
+static struct PyMethodDef batch_methods[] = {
+    {"clear", (PyCFunction)batch_clear, METH_NOARGS},
+    {"delete", (PyCFunction)batch_delete, METH_VARARGS|METH_KEYWORDS},
+    {"put", (PyCFunction)batch_put, METH_VARARGS|METH_KEYWORDS},
+    {NULL, NULL}
+};
+
+static PySequenceMethods batch_as_sequence = {
+    .sq_length = (lenfunc) batch_length
+};
+
+PyTypeObject PyWriteBatch_Type = {
+    PyObject_HEAD_INIT(0)
+    .tp_basicsize = sizeof(BatchObject),
+    .tp_dealloc = (destructor) batch_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_methods = batch_methods,
+    .tp_as_sequence = &batch_as_sequence,
+    .tp_name = "WriteBatch",
+    .tp_new = batch_new,
+};
 
-    DEBUG("sizeof cursor = %d", (int) sizeof *self)
-    OBJECT_INIT(self)
-    LINK_CHILD(trans, self)
-    self->positioned = 0;
-    self->key_buf = NULL;
-    self->val_buf = NULL;
-    self->key.mv_size = 0;
-    self->val.mv_size = 0;
-    self->item_tup = NULL;
-    self->trans = trans;
-    Py_INCREF(self->trans);
-    return (PyObject *) self;
-}
 
 // ----------------------------
 // Database
@@ -869,7 +2690,7 @@ db_from_name(EnvObject *env, MDB_txn *txn, const char *name,
     MDB_dbi dbi;
     int rc;
 
-    UNLOCKED(rc, mdb_dbi_open(txn, name, flags, &dbi));
+    UNLOCKED(rc, env, GIL_CHEAP, mdb_dbi_open(txn, name, flags, &dbi));
     if(rc) {
         err_set("mdb_dbi_open", rc);
         return NULL;
@@ -897,7 +2718,9 @@ txn_db_from_name(EnvObject *env, const char *name,
     MDB_txn *txn;
 
     int begin_flags = (name == NULL || env->readonly) ? MDB_RDONLY : 0;
-    UNLOCKED(rc, mdb_txn_begin(env->env, NULL, begin_flags, &txn));
+    UNLOCKED(rc, env,
+             (begin_flags & MDB_RDONLY) ? GIL_CHEAP : GIL_SLOW,
+             mdb_txn_begin(env->env, NULL, begin_flags, &txn));
     if(rc) {
         err_set("mdb_txn_begin", rc);
         return NULL;
@@ -905,13 +2728,13 @@ txn_db_from_name(EnvObject *env, const char *name,
 
     DbObject *dbo = db_from_name(env, txn, name, flags);
     if(! dbo) {
-        DROP_GIL
+        DROP_GIL(env, GIL_CHEAP)
         mdb_txn_abort(txn);
         LOCK_GIL
         return NULL;
     }
 
-    UNLOCKED(rc, mdb_txn_commit(txn));
+    UNLOCKED(rc, env, GIL_SLOW, mdb_txn_commit(txn));
     if(rc) {
         Py_DECREF(dbo);
         return err_set("mdb_txn_commit", rc);
@@ -957,8 +2780,10 @@ env_clear(EnvObject *self)
     DEBUG("killing env..")
     if(self->env) {
         INVALIDATE(self)
+        env_clear_snapshots(self);
+        env_clear_spares(self);
         DEBUG("Closing env")
-        DROP_GIL
+        DROP_GIL(self, GIL_SLOW)
         mdb_env_close(self->env);
         LOCK_GIL
         self->env = NULL;
@@ -966,6 +2791,7 @@ env_clear(EnvObject *self)
     if(self->main_db) {
         Py_CLEAR(self->main_db);
     }
+    Py_CLEAR(self->snap_key);
     return 0;
 }
 
@@ -973,6 +2799,8 @@ static void
 env_dealloc(EnvObject *self)
 {
     env_clear(self);
+    pthread_mutex_destroy(&self->group_lock);
+    pthread_cond_destroy(&self->group_cond);
     PyObject_Del(self);
 }
 
@@ -993,7 +2821,22 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         int writemap;
         int max_readers;
         int max_dbs;
-    } arg = {NULL, 10485760, 1, 0, 1, 1, 0, 0644, 1, 0, 126, 0};
+        int max_spare_txns;
+        int max_spare_cursors;
+        int max_spare_iters;
+        int max_staleness;
+        char *gil_policy;
+        int group_commit;
+        int sync_interval;
+        size_t sync_bytes;
+        int pipeline;
+        int auto_reader_check;
+    } arg = {NULL, 10485760, 1, 0, 1, 1, 0, 0644, 1, 0, 126, 0, 1, 32, 32, -1,
+             NULL, 0, 0, 0, 0, 0};
+
+    // max_spare_cursors and max_spare_iters are accepted for compatibility
+    // with the cffi binding but unused, and keep later arguments at the same
+    // positions in both.
 
     static const struct argspec argspec[] = {
         {ARG_STR, PATH_S, OFFSET(env_new, path)},
@@ -1008,6 +2851,16 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         {ARG_BOOL, WRITEMAP_S, OFFSET(env_new, writemap)},
         {ARG_INT, MAX_READERS_S, OFFSET(env_new, max_readers)},
         {ARG_INT, MAX_DBS_S, OFFSET(env_new, max_dbs)},
+        {ARG_INT, MAX_SPARE_TXNS_S, OFFSET(env_new, max_spare_txns)},
+        {ARG_INT, MAX_SPARE_CURSORS_S, OFFSET(env_new, max_spare_cursors)},
+        {ARG_INT, MAX_SPARE_ITERS_S, OFFSET(env_new, max_spare_iters)},
+        {ARG_INT, MAX_STALENESS_S, OFFSET(env_new, max_staleness)},
+        {ARG_STR, GIL_POLICY_S, OFFSET(env_new, gil_policy)},
+        {ARG_BOOL, GROUP_COMMIT_S, OFFSET(env_new, group_commit)},
+        {ARG_INT, SYNC_INTERVAL_S, OFFSET(env_new, sync_interval)},
+        {ARG_SIZE, SYNC_BYTES_S, OFFSET(env_new, sync_bytes)},
+        {ARG_BOOL, PIPELINE_S, OFFSET(env_new, pipeline)},
+        {ARG_BOOL, AUTO_READER_CHECK_S, OFFSET(env_new, auto_reader_check)},
     };
 
     if(parse_args(1, SPECSIZE(), argspec, args, kwds, &arg)) {
@@ -1018,6 +2871,18 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         return type_error("'path' argument required");
     }
 
+    int gil_policy = GIL_AUTO;
+    if(arg.gil_policy) {
+        if(! strcmp(arg.gil_policy, "never")) {
+            gil_policy = GIL_NEVER;
+        } else if(! strcmp(arg.gil_policy, "always")) {
+            gil_policy = GIL_ALWAYS;
+        } else if(strcmp(arg.gil_policy, "auto")) {
+            return type_error("gil_policy must be 'auto', 'always' or "
+                              "'never'");
+        }
+    }
+
     EnvObject *self = PyObject_New(EnvObject, type);
     if(! self) {
         return NULL;
@@ -1026,6 +2891,29 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     OBJECT_INIT(self)
     self->main_db = NULL;
     self->env = NULL;
+    self->gil_policy = gil_policy;
+    self->gil_released = 0;
+    self->gil_kept = 0;
+    self->spare_txns = NULL;
+    self->max_spare_txns = 0;
+    self->spare_count = 0;
+    self->spare_hits = 0;
+    self->spare_misses = 0;
+    self->max_staleness = arg.max_staleness;
+    self->snapshots = NULL;
+    self->snap_hits = 0;
+    self->snap_misses = 0;
+    self->group_commit = arg.group_commit;
+    pthread_mutex_init(&self->group_lock, NULL);
+    pthread_cond_init(&self->group_cond, NULL);
+    self->group_head = NULL;
+    self->group_tail = &self->group_head;
+    self->group_busy = 0;
+    self->group_commits = 0;
+    self->group_writes = 0;
+    if(! ((self->snap_key = PyLong_FromVoidPtr(self)))) {
+        goto fail;
+    }
 
     int rc;
     if((rc = mdb_env_create(&self->env))) {
@@ -1033,6 +2921,15 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         goto fail;
     }
 
+    if(arg.max_spare_txns) {
+        self->spare_txns = malloc(sizeof(MDB_txn *) * arg.max_spare_txns);
+        if(! self->spare_txns) {
+            PyErr_NoMemory();
+            goto fail;
+        }
+        self->max_spare_txns = arg.max_spare_txns;
+    }
+
     if((rc = mdb_env_set_mapsize(self->env, arg.map_size))) {
         err_set("mdb_env_set_mapsize", rc);
         goto fail;
@@ -1048,6 +2945,13 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         goto fail;
     }
 
+    if((arg.sync_interval || arg.sync_bytes) &&
+       (rc = mdb_env_set_syncparams(self->env, arg.sync_interval,
+                                    arg.sync_bytes))) {
+        err_set("mdb_env_set_syncparams", rc);
+        goto fail;
+    }
+
     if(arg.create && arg.subdir) {
         struct stat st;
         errno = 0;
@@ -1071,7 +2975,8 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     if(! arg.metasync) {
         flags |= MDB_NOMETASYNC;
     }
-    if(! arg.sync) {
+    // The background thread flushes instead of each commit.
+    if(! arg.sync || arg.sync_interval || arg.sync_bytes) {
         flags |= MDB_NOSYNC;
     }
     if(arg.map_async) {
@@ -1080,9 +2985,16 @@ env_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     if(arg.writemap) {
         flags |= MDB_WRITEMAP;
     }
+    if(arg.pipeline) {
+        flags |= MDB_PIPELINE;
+    }
+    if(arg.auto_reader_check) {
+        flags |= MDB_READERCHECK;
+    }
 
     DEBUG("mdb_env_open(%p, '%s', %d, %o);", self->env, arg.path, flags, arg.mode)
-    UNLOCKED(rc, mdb_env_open(self->env, arg.path, flags, arg.mode));
+    UNLOCKED(rc, self, GIL_SLOW,
+             mdb_env_open(self->env, arg.path, flags, arg.mode));
     if(rc) {
         err_set(arg.path, rc);
         goto fail;
@@ -1129,9 +3041,11 @@ env_close(EnvObject *self)
 {
     if(self->valid) {
         INVALIDATE(self)
+        env_clear_snapshots(self);
+        env_clear_spares(self);
         self->valid = 0;
         DEBUG("Closing env")
-        DROP_GIL
+        DROP_GIL(self, GIL_SLOW)
         mdb_env_close(self->env);
         LOCK_GIL
         self->env = NULL;
@@ -1172,7 +3086,7 @@ env_info(EnvObject *self)
 
     MDB_envinfo info;
     int rc;
-    UNLOCKED(rc, mdb_env_info(self->env, &info));
+    UNLOCKED(rc, self, GIL_CHEAP, mdb_env_info(self->env, &info));
     if(rc) {
         err_set("mdb_env_info", rc);
         return NULL;
@@ -1181,6 +3095,30 @@ env_info(EnvObject *self)
 }
 
 
+static PyObject *
+env_counters(EnvObject *self)
+{
+    static const struct dict_field fields[] = {
+        { TYPE_UINT, "spare_txns",      offsetof(EnvObject, spare_count) },
+        { TYPE_UINT, "max_spare_txns",  offsetof(EnvObject, max_spare_txns) },
+        { TYPE_SIZE, "spare_txn_hits",  offsetof(EnvObject, spare_hits) },
+        { TYPE_SIZE, "spare_txn_misses", offsetof(EnvObject, spare_misses) },
+        { TYPE_SIZE, "snapshot_hits",   offsetof(EnvObject, snap_hits) },
+        { TYPE_SIZE, "snapshot_misses", offsetof(EnvObject, snap_misses) },
+        { TYPE_SIZE, "gil_released",    offsetof(EnvObject, gil_released) },
+        { TYPE_SIZE, "gil_kept",        offsetof(EnvObject, gil_kept) },
+        { TYPE_SIZE, "group_commits",   offsetof(EnvObject, group_commits) },
+        { TYPE_SIZE, "group_writes",    offsetof(EnvObject, group_writes) },
+        { TYPE_EOF, NULL, 0 }
+    };
+
+    if(! self->valid) {
+        return err_invalid();
+    }
+    return dict_from_fields(self, fields);
+}
+
+
 static PyObject *
 env_open_db(EnvObject *self, PyObject *args, PyObject *kwds)
 {
@@ -1216,6 +3154,14 @@ env_open_db(EnvObject *self, PyObject *args, PyObject *kwds)
     }
 
     if(arg.txn) {
+        if(! arg.txn->valid) {
+            return err_invalid();
+        }
+        // Handles opened in a read-only txn are only exported by
+        // mdb_txn_commit(), so it must not be reset into the spare list.
+        arg.txn->flags &= ~TRANS_SPARE;
+        // Creating a database inserts into the main database.
+        trans_end_reserve(arg.txn);
         return (PyObject *) db_from_name(self, arg.txn->txn, arg.name, flags);
     } else {
         return (PyObject *) txn_db_from_name(self, arg.name, flags);
@@ -1258,7 +3204,7 @@ env_stat(EnvObject *self)
 
     MDB_stat st;
     int rc;
-    UNLOCKED(rc, mdb_env_stat(self->env, &st));
+    UNLOCKED(rc, self, GIL_CHEAP, mdb_env_stat(self->env, &st));
     if(rc) {
         err_set("mdb_env_stat", rc);
         return NULL;
@@ -1282,7 +3228,7 @@ env_sync(EnvObject *self, PyObject *args)
     }
 
     int rc;
-    UNLOCKED(rc, mdb_env_sync(self->env, arg.force));
+    UNLOCKED(rc, self, GIL_SLOW, mdb_env_sync(self->env, arg.force));
     if(rc) {
         return err_set("mdb_env_sync", rc);
     }
@@ -1290,23 +3236,94 @@ env_sync(EnvObject *self, PyObject *args)
 }
 
 static PyObject *
-env_get(EnvObject *self, PyObject *args, PyObject *kwds)
+env_durable_txnid(EnvObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+
+    size_t txnid;
+    int rc = mdb_env_durable(self->env, &txnid);
+    if(rc) {
+        return err_set("mdb_env_durable", rc);
+    }
+    return PyLong_FromSize_t(txnid);
+}
+
+static PyObject *
+env_wait_durable(EnvObject *self, PyObject *args, PyObject *kwds)
+{
+    struct env_wait_durable {
+        size_t txnid;
+        int timeout;
+    } arg = {0, -1};
+
+    static const struct argspec argspec[] = {
+        {ARG_SIZE, TXNID_S, OFFSET(env_wait_durable, txnid)},
+        {ARG_INT, TIMEOUT_S, OFFSET(env_wait_durable, timeout)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+
+    int rc;
+    if(! arg.txnid) {
+        MDB_envinfo info;
+        if((rc = mdb_env_info(self->env, &info))) {
+            return err_set("mdb_env_info", rc);
+        }
+        arg.txnid = info.me_last_txnid;
+    }
+
+    UNLOCKED(rc, self, GIL_SLOW,
+             mdb_env_wait_durable(self->env, arg.txnid, arg.timeout));
+    if(rc == ETIMEDOUT) {
+        Py_RETURN_FALSE;
+    } else if(rc) {
+        return err_set("mdb_env_wait_durable", rc);
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+env_reader_check(EnvObject *self)
 {
     if(! self->valid) {
         return err_invalid();
     }
 
-    MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, MDB_RDONLY, &txn));
+    int dead;
+    UNLOCKED(rc, self, GIL_SLOW, mdb_reader_check(self->env, &dead));
     if(rc) {
+        return err_set("mdb_reader_check", rc);
+    }
+    return PyLong_FromLong(dead);
+}
+
+static PyObject *
+env_get(EnvObject *self, FAST_ARGS_DECL)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+
+    MDB_txn *txn;
+    if(self->max_staleness >= 0) {
+        if(! ((txn = env_snapshot_txn(self)))) {
+            return NULL;
+        }
+        return generic_get(1, txn, self->main_db, NULL, FAST_ARGS);
+    }
+
+    int rc;
+    if((rc = env_txn_begin(self, &txn))) {
         return err_set("mdb_txn_begin", rc);
     }
 
-    PyObject *ret = generic_get(1, txn, self->main_db, 0, NULL, args, kwds);
-    DROP_GIL
-    mdb_txn_abort(txn);
-    LOCK_GIL
+    PyObject *ret = generic_get(1, txn, self->main_db, NULL, FAST_ARGS);
+    env_txn_release(self, txn);
     return ret;
 }
 
@@ -1317,11 +3334,13 @@ env_gets(EnvObject *self, PyObject *args, PyObject *kwds)
     struct env_gets {
         PyObject *keys;
         DbObject *db;
-    } arg = {NULL, self->main_db};
+        int sort;
+    } arg = {NULL, self->main_db, 0};
 
     static const struct argspec argspec[] = {
         {ARG_OBJ, KEYS_S, OFFSET(env_gets, keys)},
-        {ARG_DB, DB_S, OFFSET(env_gets, db)}
+        {ARG_DB, DB_S, OFFSET(env_gets, db)},
+        {ARG_BOOL, SORT_S, OFFSET(env_gets, sort)}
     };
 
     if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
@@ -1332,66 +3351,26 @@ env_gets(EnvObject *self, PyObject *args, PyObject *kwds)
         return type_error("keys must be given");
     }
 
-    PyObject *iter = PyObject_GetIter(arg.keys);
-    if(! iter) {
-        return NULL;
-    }
-
-    PyObject *dict = PyDict_New();
-    if(! dict) {
-        Py_DECREF(iter);
-        return NULL;
+    MDB_txn *txn;
+    if(self->max_staleness >= 0) {
+        if(! ((txn = env_snapshot_txn(self)))) {
+            return NULL;
+        }
+        return multi_get(txn, arg.db, arg.keys, Py_None, 1, arg.sort);
     }
 
-    MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, MDB_RDONLY, &txn));
-    if(rc) {
-        Py_DECREF(iter);
-        Py_DECREF(dict);
+    if((rc = env_txn_begin(self, &txn))) {
         return err_set("mdb_txn_begin", rc);
     }
 
-    PyObject *key_obj;
-    MDB_val key;
-    MDB_val val;
-
-    while((key_obj = PyIter_Next(iter)) != NULL) {
-        if(val_from_buffer(&key, key_obj)) {
-            break;
-        }
-
-        UNLOCKED(rc, mdb_get(txn, arg.db->dbi, &key, &val));
-        if(rc == 0) {
-            PyObject *val_obj = string_from_val(&val);
-            if(! val_obj) {
-                break;
-            }
-            rc = PyDict_SetItem(dict, key_obj, val_obj);
-            Py_DECREF(val_obj);
-            if(rc) {
-                break;
-            }
-        } else if(rc != MDB_NOTFOUND) {
-            err_set("mdb_get", rc);
-            break;
-        }
-        Py_DECREF(key_obj);
-    }
-
-    DROP_GIL
-    mdb_txn_abort(txn);
-    LOCK_GIL
-    Py_DECREF(iter);
-    Py_XDECREF(key_obj);
-    if(PyErr_Occurred()) {
-        Py_CLEAR(dict);
-    }
+    PyObject *dict = multi_get(txn, arg.db, arg.keys, Py_None, 1, arg.sort);
+    env_txn_release(self, txn);
     return dict;
 }
 
 static PyObject *
-env_put(EnvObject *self, PyObject *args, PyObject *kwds)
+env_put(EnvObject *self, FAST_ARGS_DECL)
 {
     if(! self->valid) {
         return err_invalid();
@@ -1399,20 +3378,20 @@ env_put(EnvObject *self, PyObject *args, PyObject *kwds)
 
     MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, 0, &txn));
+    UNLOCKED(rc, self, GIL_SLOW, mdb_txn_begin(self->env, NULL, 0, &txn));
     if(rc) {
         return err_set("mdb_txn_begin", rc);
     }
 
-    PyObject *ret = generic_put(1, txn, self->main_db, args, kwds);
+    PyObject *ret = generic_put(1, txn, self->main_db, FAST_ARGS);
     if(ret) {
-        UNLOCKED(rc, mdb_txn_commit(txn));
+        UNLOCKED(rc, self, GIL_SLOW, mdb_txn_commit(txn));
         if(rc) {
             Py_DECREF(ret);
             ret = err_set("mdb_txn_commit", rc);
         }
     } else {
-        DROP_GIL
+        DROP_GIL(self, GIL_CHEAP)
         mdb_txn_abort(txn);
         LOCK_GIL
     }
@@ -1465,7 +3444,7 @@ env_puts(EnvObject *self, PyObject *args, PyObject *kwds)
 
     MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, 0, &txn));
+    UNLOCKED(rc, self, GIL_SLOW, mdb_txn_begin(self->env, NULL, 0, &txn));
     if(rc) {
         Py_DECREF(iter);
         Py_DECREF(list);
@@ -1503,7 +3482,8 @@ env_puts(EnvObject *self, PyObject *args, PyObject *kwds)
         DEBUG("inserting '%.*s' (%d) -> '%.*s' (%d)",
             (int)key.mv_size, (char *)key.mv_data, (int)key.mv_size,
             (int)val.mv_size, (char *)val.mv_data, (int)val.mv_size)
-        UNLOCKED(rc, mdb_put(txn, arg.db->dbi, &key, &val, flags));
+        UNLOCKED(rc, self, LARGE_COST(val.mv_size),
+                 mdb_put(txn, arg.db->dbi, &key, &val, flags));
         Py_DECREF(item);
 
         PyObject *res;
@@ -1525,13 +3505,13 @@ env_puts(EnvObject *self, PyObject *args, PyObject *kwds)
     Py_DECREF(iter);
     if(PyErr_Occurred()) {
         DEBUG("abort")
-        DROP_GIL
+        DROP_GIL(self, GIL_CHEAP)
         mdb_txn_abort(txn);
         LOCK_GIL
         Py_CLEAR(list);
     } else {
         DEBUG("commit")
-        UNLOCKED(rc, mdb_txn_commit(txn));
+        UNLOCKED(rc, self, GIL_SLOW, mdb_txn_commit(txn));
         if(rc) {
             err_set("mdb_txn_commit", rc);
             Py_CLEAR(list);
@@ -1541,7 +3521,7 @@ env_puts(EnvObject *self, PyObject *args, PyObject *kwds)
 }
 
 static PyObject *
-env_delete(EnvObject *self, PyObject *args, PyObject *kwds)
+env_delete(EnvObject *self, FAST_ARGS_DECL)
 {
     if(! self->valid) {
         return err_invalid();
@@ -1549,20 +3529,20 @@ env_delete(EnvObject *self, PyObject *args, PyObject *kwds)
 
     MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, 0, &txn));
+    UNLOCKED(rc, self, GIL_SLOW, mdb_txn_begin(self->env, NULL, 0, &txn));
     if(rc) {
         return err_set("mdb_txn_begin", rc);
     }
 
-    PyObject *ret = generic_delete(1, txn, self->main_db, args, kwds);
+    PyObject *ret = generic_delete(1, txn, self->main_db, FAST_ARGS);
     if(ret) {
-        UNLOCKED(rc, mdb_txn_commit(txn));
+        UNLOCKED(rc, self, GIL_SLOW, mdb_txn_commit(txn));
         if(rc) {
             Py_DECREF(ret);
             ret = err_set("mdb_txn_commit", rc);
         }
     } else {
-        DROP_GIL
+        DROP_GIL(self, GIL_CHEAP)
         mdb_txn_abort(txn);
         LOCK_GIL
     }
@@ -1603,7 +3583,7 @@ env_deletes(EnvObject *self, PyObject *args, PyObject *kwds)
 
     MDB_txn *txn;
     int rc;
-    UNLOCKED(rc, mdb_txn_begin(self->env, NULL, 0, &txn));
+    UNLOCKED(rc, self, GIL_SLOW, mdb_txn_begin(self->env, NULL, 0, &txn));
     if(rc) {
         return err_set("mdb_txn_begin", rc);
     }
@@ -1615,7 +3595,7 @@ env_deletes(EnvObject *self, PyObject *args, PyObject *kwds)
             break;
         }
 
-        UNLOCKED(rc, mdb_del(txn, arg.db->dbi, &key, NULL));
+        UNLOCKED(rc, self, GIL_CHEAP, mdb_del(txn, arg.db->dbi, &key, NULL));
         Py_DECREF(key_obj);
 
         PyObject *res;
@@ -1633,12 +3613,12 @@ env_deletes(EnvObject *self, PyObject *args, PyObject *kwds)
     }
 
     if(PyErr_Occurred()) {
-        DROP_GIL
+        DROP_GIL(self, GIL_CHEAP)
         mdb_txn_abort(txn);
         LOCK_GIL
         Py_CLEAR(list);
     } else {
-        UNLOCKED(rc, mdb_txn_commit(txn));
+        UNLOCKED(rc, self, GIL_SLOW, mdb_txn_commit(txn));
         if(rc) {
             Py_CLEAR(list);
             err_set("mdb_txn_commit", rc);
@@ -1676,22 +3656,128 @@ env_cursor(EnvObject *self, PyObject *args, PyObject *kwds)
     return cursor;
 }
 
+/**
+ * Environment.write(batch, sort=False) -> list
+ *
+ * Apply a WriteBatch in one write transaction, shared with concurrent callers
+ * if group_commit is enabled. Python objects were already converted when the
+ * batch was built, so the write lock is held only while the GIL is released.
+ */
+static PyObject *
+env_write(EnvObject *self, PyObject *args, PyObject *kwds)
+{
+    struct env_write {
+        PyObject *batch;
+        int sort;
+    } arg = {NULL, 0};
+
+    static const struct argspec argspec[] = {
+        {ARG_OBJ, BATCH_S, OFFSET(env_write, batch)},
+        {ARG_BOOL, SORT_S, OFFSET(env_write, sort)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! (arg.batch && Py_TYPE(arg.batch) == &PyWriteBatch_Type)) {
+        return type_error("batch must be a WriteBatch.");
+    }
+    BatchObject *batch = (BatchObject *) arg.batch;
+    if(batch->busy) {
+        return err_set("WriteBatch", EBUSY);
+    }
+    if(self->readonly) {
+        return err_set("Cannot start write transaction with read-only env", 0);
+    }
+
+    size_t n = batch->ops.size / sizeof(struct batch_op);
+    Py_ssize_t ndbs = PyList_GET_SIZE(batch->dbs);
+    struct batch_ctx ctx = {
+        NULL,
+        (struct batch_op *) batch->ops.data,
+        batch->data.data,
+        self->main_db->dbi,
+        malloc(sizeof(MDB_dbi) * (ndbs + 1)),
+        n,
+        arg.sort ? malloc(sizeof(size_t) * 2 * (n + 1)) : NULL,
+        malloc(n + 1)
+    };
+    PyObject *list = NULL;
+    if(! (ctx.dbis && ctx.results && (ctx.idx || ! arg.sort))) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    Py_ssize_t i;
+    for(i = 0; i < ndbs; i++) {
+        DbObject *db = (DbObject *) PyList_GET_ITEM(batch->dbs, i);
+        if(! db->valid) {
+            err_invalid();
+            goto out;
+        }
+        if(db->env != self) {
+            type_error("batch refers to a database of another Environment.");
+            goto out;
+        }
+        ctx.dbis[i] = db->dbi;
+    }
+
+    // Other threads may run while the GIL is released, and must not move the
+    // batch's blobs.
+    batch->busy = 1;
+    DROP_GIL(self, GIL_SLOW)
+    if(! (ctx.idx && batch_sort_ops(self, &ctx))) {
+        if(self->group_commit) {
+            group_write(self, &ctx);
+        } else {
+            batch_write(self, &ctx);
+        }
+    }
+    LOCK_GIL
+    batch->busy = 0;
+    if(ctx.rc) {
+        err_set(ctx.what, ctx.rc);
+        goto out;
+    }
+
+    if(! ((list = PyList_New(n)))) {
+        goto out;
+    }
+    for(i = 0; i < (Py_ssize_t) n; i++) {
+        PyObject *res = ctx.results[i] ? Py_True : Py_False;
+        Py_INCREF(res);
+        PyList_SET_ITEM(list, i, res);
+    }
+
+out:
+    free(ctx.dbis);
+    free(ctx.idx);
+    free(ctx.results);
+    return list;
+}
+
 static struct PyMethodDef env_methods[] = {
     {"begin", (PyCFunction)env_begin, METH_VARARGS|METH_KEYWORDS},
     {"close", (PyCFunction)env_close, METH_NOARGS},
     {"copy", (PyCFunction)env_copy, METH_VARARGS},
+    {"counters", (PyCFunction)env_counters, METH_NOARGS},
+    {"durable_txnid", (PyCFunction)env_durable_txnid, METH_NOARGS},
     {"info", (PyCFunction)env_info, METH_NOARGS},
     {"open_db", (PyCFunction)env_open_db, METH_VARARGS|METH_KEYWORDS},
     {"path", (PyCFunction)env_path, METH_NOARGS},
+    {"reader_check", (PyCFunction)env_reader_check, METH_NOARGS},
     {"stat", (PyCFunction)env_stat, METH_NOARGS},
     {"sync", (PyCFunction)env_sync, METH_VARARGS},
-    {"get", (PyCFunction)env_get, METH_VARARGS|METH_KEYWORDS},
+    {"wait_durable", (PyCFunction)env_wait_durable,
+        METH_VARARGS|METH_KEYWORDS},
+    {"get", (PyCFunction)env_get, METH_FAST},
     {"gets", (PyCFunction)env_gets, METH_VARARGS|METH_KEYWORDS},
-    {"put", (PyCFunction)env_put, METH_VARARGS|METH_KEYWORDS},
+    {"put", (PyCFunction)env_put, METH_FAST},
     {"puts", (PyCFunction)env_puts, METH_VARARGS|METH_KEYWORDS},
-    {"delete", (PyCFunction)env_delete, METH_VARARGS|METH_KEYWORDS},
+    {"delete", (PyCFunction)env_delete, METH_FAST},
     {"deletes", (PyCFunction)env_deletes, METH_VARARGS|METH_KEYWORDS},
     {"cursor", (PyCFunction)env_cursor, METH_VARARGS|METH_KEYWORDS},
+    {"write", (PyCFunction)env_write, METH_VARARGS|METH_KEYWORDS},
     {NULL, NULL}
 };
 
@@ -1718,22 +3804,11 @@ cursor_clear(CursorObject *self)
     if(self->valid) {
         INVALIDATE(self)
         UNLINK_CHILD(self->trans, self)
-        DROP_GIL
+        DROP_GIL(self->trans->env, GIL_CHEAP)
         mdb_cursor_close(self->curs);
         LOCK_GIL
         self->valid = 0;
     }
-    if(self->key_buf) {
-        SET_BUFFER(self->key_buf, "", 0);
-        Py_CLEAR(self->key_buf);
-    }
-    if(self->val_buf) {
-        SET_BUFFER(self->val_buf, "", 0);
-        Py_CLEAR(self->val_buf);
-    }
-    if(self->item_tup) {
-        Py_CLEAR(self->item_tup);
-    }
     Py_CLEAR(self->trans);
     return 0;
 }
@@ -1778,7 +3853,8 @@ cursor_count(CursorObject *self)
 
     size_t count;
     int rc;
-    UNLOCKED(rc, mdb_cursor_count(self->curs, &count));
+    UNLOCKED(rc, self->trans->env, GIL_CHEAP,
+             mdb_cursor_count(self->curs, &count));
     if(rc) {
         return err_set("mdb_cursor_count", rc);
     }
@@ -1786,12 +3862,21 @@ cursor_count(CursorObject *self)
 }
 
 
+/**
+ * Move the cursor using `op`. If `keys_only` is 1, the value is not resolved,
+ * which for large values avoids locating their overflow pages; it is fetched
+ * later by cursor_load_val() if needed. Only valid on databases without
+ * duplicates.
+ */
 static int
-_cursor_get_c(CursorObject *self, enum MDB_cursor_op op)
+_cursor_move(CursorObject *self, enum MDB_cursor_op op, int keys_only)
 {
     int rc;
-    UNLOCKED(rc, mdb_cursor_get(self->curs, &self->key, &self->val, op));
+    UNLOCKED(rc, self->trans->env, GIL_CHEAP,
+             mdb_cursor_get(self->curs, &self->key,
+                            keys_only ? NULL : &self->val, op));
     self->positioned = rc == 0;
+    self->val_stale = keys_only && ! rc;
     if(rc) {
         self->key.mv_size = 0;
         self->val.mv_size = 0;
@@ -1805,6 +3890,48 @@ _cursor_get_c(CursorObject *self, enum MDB_cursor_op op)
     return 0;
 }
 
+static int
+_cursor_get_c(CursorObject *self, enum MDB_cursor_op op)
+{
+    return _cursor_move(self, op, 0);
+}
+
+/**
+ * Fetch the current value if the cursor was last moved by a key-only step.
+ * The value is looked up by key, since a batched iterator leaves the MDB
+ * cursor ahead of the element it returned. Returns -1 on error.
+ */
+static int
+cursor_load_val(CursorObject *self)
+{
+    if(! self->val_stale) {
+        return 0;
+    }
+    int rc;
+    UNLOCKED(rc, self->trans->env, GIL_CHEAP,
+             mdb_get(self->trans->txn, mdb_cursor_dbi(self->curs),
+                     &self->key, &self->val));
+    if(rc) {
+        err_set("mdb_get", rc);
+        return -1;
+    }
+    self->val_stale = 0;
+    return 0;
+}
+
+/**
+ * Return 1 if `curs`'s database may contain duplicate keys.
+ */
+static int
+cursor_dupsort(CursorObject *curs)
+{
+    unsigned int flags;
+    if(mdb_dbi_flags(curs->trans->txn, mdb_cursor_dbi(curs->curs), &flags)) {
+        return 1;
+    }
+    return (flags & MDB_DUPSORT) != 0;
+}
+
 
 static PyObject *
 _cursor_get(CursorObject *self, enum MDB_cursor_op op)
@@ -1829,8 +3956,10 @@ cursor_delete(CursorObject *self)
         DEBUG("deleting key '%.*s'",
               (int) self->key.mv_size,
               (char*) self->key.mv_data)
+        trans_end_reserve(self->trans);
         int rc;
-        UNLOCKED(rc, mdb_cursor_del(self->curs, 0));
+        UNLOCKED(rc, self->trans->env, GIL_CHEAP,
+                 mdb_cursor_del(self->curs, 0));
         if(rc) {
             return err_set("mdb_cursor_del", rc);
         }
@@ -1857,7 +3986,7 @@ cursor_value(CursorObject *self);
 
 
 static PyObject *
-cursor_get(CursorObject *self, PyObject *args, PyObject *kwds)
+cursor_get(CursorObject *self, FAST_ARGS_DECL)
 {
     if(! self->valid) {
         return err_invalid();
@@ -1873,7 +4002,7 @@ cursor_get(CursorObject *self, PyObject *args, PyObject *kwds)
         {ARG_OBJ, DEFAULT_S, OFFSET(cursor_get, default_)}
     };
 
-    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
         return NULL;
     }
 
@@ -1899,35 +4028,36 @@ cursor_item(CursorObject *self)
     if(! self->valid) {
         return err_invalid();
     }
+    if(cursor_load_val(self)) {
+        return NULL;
+    }
+    PyObject *key;
+    PyObject *val;
     if(self->trans->buffers) {
-        if(! buffer_from_val(&self->key_buf, &self->key)) {
-            return NULL;
-        }
-        if(! buffer_from_val(&self->val_buf, &self->val)) {
-            return NULL;
-        }
-        if(! self->item_tup) {
-            self->item_tup = PyTuple_Pack(2, self->key_buf, self->val_buf);
-        }
-        Py_INCREF(self->item_tup);
-        return self->item_tup;
+        key = make_buf(self->trans, &self->key);
+    } else {
+        key = string_from_val(self->trans->env, &self->key);
     }
-
-    PyObject *key = string_from_val(&self->key);
     if(! key) {
         return NULL;
     }
-    PyObject *val = string_from_val(&self->val);
+    if(self->trans->buffers) {
+        val = make_buf(self->trans, &self->val);
+    } else {
+        val = string_from_val(self->trans->env, &self->val);
+    }
     if(! val) {
         Py_DECREF(key);
         return NULL;
     }
-    PyObject *tup = PyTuple_Pack(2, key, val);
+    PyObject *tup = PyTuple_New(2);
     if(! tup) {
         Py_DECREF(key);
         Py_DECREF(val);
         return NULL;
     }
+    PyTuple_SET_ITEM(tup, 0, key);
+    PyTuple_SET_ITEM(tup, 1, val);
     return tup;
 }
 
@@ -1938,13 +4068,9 @@ cursor_key(CursorObject *self)
         return err_invalid();
     }
     if(self->trans->buffers) {
-        if(! buffer_from_val(&self->key_buf, &self->key)) {
-            return NULL;
-        }
-        Py_INCREF(self->key_buf);
-        return (PyObject *) self->key_buf;
+        return make_buf(self->trans, &self->key);
     }
-    return string_from_val(&self->key);
+    return string_from_val(self->trans->env, &self->key);
 }
 
 static PyObject *
@@ -1975,7 +4101,7 @@ cursor_prev(CursorObject *self)
 }
 
 static PyObject *
-cursor_put(CursorObject *self, PyObject *args, PyObject *kwds)
+cursor_put(CursorObject *self, FAST_ARGS_DECL)
 {
     struct cursor_put {
         MDB_val key;
@@ -1993,7 +4119,7 @@ cursor_put(CursorObject *self, PyObject *args, PyObject *kwds)
         {ARG_BOOL, APPEND_S, OFFSET(cursor_put, append)}
     };
 
-    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
         return NULL;
     }
 
@@ -2008,8 +4134,10 @@ cursor_put(CursorObject *self, PyObject *args, PyObject *kwds)
         flags |= MDB_APPEND;
     }
 
+    trans_end_reserve(self->trans);
     int rc;
-    UNLOCKED(rc, mdb_cursor_put(self->curs, &arg.key, &arg.val, flags));
+    UNLOCKED(rc, self->trans->env, LARGE_COST(arg.val.mv_size),
+             mdb_cursor_put(self->curs, &arg.key, &arg.val, flags));
     if(rc) {
         if(rc == MDB_KEYEXIST) {
             Py_RETURN_FALSE;
@@ -2053,20 +4181,127 @@ cursor_value(CursorObject *self)
     if(! self->valid) {
         return err_invalid();
     }
+    if(cursor_load_val(self)) {
+        return NULL;
+    }
     if(self->trans->buffers) {
-        if(! buffer_from_val(&self->val_buf, &self->val)) {
-            return NULL;
-        }
-        Py_INCREF(self->val_buf);
-        return (PyObject *) self->val_buf;
+        return make_buf(self->trans, &self->val);
+    }
+    return string_from_val(self->trans->env, &self->val);
+}
+
+/**
+ * Cursor.value_range(offset=0, length=None)
+ */
+static PyObject *
+cursor_value_range(CursorObject *self, FAST_ARGS_DECL)
+{
+    struct cursor_value_range {
+        size_t offset;
+        size_t length;
+    } arg = {0, (size_t) -1};
+
+    static const struct argspec argspec[] = {
+        {ARG_SIZE, OFFSET_S, OFFSET(cursor_value_range, offset)},
+        {ARG_SIZE, LENGTH_S, OFFSET(cursor_value_range, length)}
+    };
+
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
+        return NULL;
+    }
+    if(cursor_load_val(self)) {
+        return NULL;
+    }
+    MDB_val val = self->val;
+    slice_val(&val, arg.offset, arg.length);
+    if(self->trans->buffers) {
+        return make_buf(self->trans, &val);
+    }
+    return string_from_val(self->trans->env, &val);
+}
+
+/**
+ * Cursor.value_into(buffer, offset=0) -> int
+ */
+static PyObject *
+cursor_value_into(CursorObject *self, FAST_ARGS_DECL)
+{
+    struct cursor_value_into {
+        PyObject *buffer;
+        size_t offset;
+    } arg = {NULL, 0};
+
+    static const struct argspec argspec[] = {
+        {ARG_OBJ, BUFFER_S, OFFSET(cursor_value_into, buffer)},
+        {ARG_SIZE, OFFSET_S, OFFSET(cursor_value_into, offset)}
+    };
+
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
+        return NULL;
+    }
+    if(! arg.buffer) {
+        return type_error("buffer must be given.");
+    }
+    if(! self->positioned) {
+        return PyLong_FromLong(-1);
+    }
+    if(cursor_load_val(self)) {
+        return NULL;
     }
-    return string_from_val(&self->val);
+    return val_into_buffer(self->trans->env, &self->val, arg.buffer,
+                           arg.offset);
 }
 
 // ==================================
 // Cursor iteration
 // ==================================
 
+/**
+ * Return a new iterator yielding the cursor's current element, then
+ * repeatedly moving it using `op`. If `batch` is >1 and the transaction is
+ * read-only, up to `batch` elements are fetched at a time with the GIL
+ * released once, see iter_fill().
+ */
+static PyObject *
+make_iter(CursorObject *curs, enum MDB_cursor_op op,
+          PyObject *(*val_func)(CursorObject *), int batch)
+{
+    IterObject *iter = PyObject_New(IterObject, &PyIterator_Type);
+    if(! iter) {
+        return NULL;
+    }
+
+    iter->batch = NULL;
+    iter->batch_size = 0;
+    iter->batch_pos = 0;
+    iter->batch_len = 0;
+    iter->batch_eof = 0;
+    iter->done = 0;
+    iter->remaining = -1;
+    iter->has_stop = 0;
+    iter->include_stop = 0;
+    iter->stop.mv_data = NULL;
+    iter->stop.mv_size = 0;
+    iter->has_prefix = 0;
+    iter->prefix.mv_data = NULL;
+    iter->prefix.mv_size = 0;
+    if(batch > 1 && (curs->trans->flags & TRANS_RDONLY)) {
+        if(! ((iter->batch = malloc(sizeof(MDB_val) * 2 * batch)))) {
+            PyObject_Del(iter);
+            return PyErr_NoMemory();
+        }
+        iter->batch_size = batch;
+    }
+
+    iter->val_func = val_func;
+    iter->keys_only = val_func == cursor_key && ! cursor_dupsort(curs);
+    iter->curs = curs;
+    Py_INCREF(curs);
+    iter->started = 0;
+    iter->op = op;
+    return (PyObject *) iter;
+}
+
 static PyObject *
 iter_from_args(CursorObject *self, PyObject *args, PyObject *kwds,
                enum MDB_cursor_op pos_op, enum MDB_cursor_op op)
@@ -2074,11 +4309,13 @@ iter_from_args(CursorObject *self, PyObject *args, PyObject *kwds,
     struct iter_from_args {
         int keys;
         int values;
-    } arg = {1, 1};
+        int batch;
+    } arg = {1, 1, 1};
 
     static const struct argspec argspec[] = {
         {ARG_BOOL, KEYS_S, OFFSET(iter_from_args, keys)},
-        {ARG_BOOL, VALUES_S, OFFSET(iter_from_args, values)}
+        {ARG_BOOL, VALUES_S, OFFSET(iter_from_args, values)},
+        {ARG_INT, BATCH_S, OFFSET(iter_from_args, batch)}
     };
 
     if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
@@ -2091,24 +4328,15 @@ iter_from_args(CursorObject *self, PyObject *args, PyObject *kwds,
         }
     }
 
-    IterObject *iter = PyObject_New(IterObject, &PyIterator_Type);
-    if(! iter) {
-        return NULL;
-    }
-
+    PyObject *(*val_func)(CursorObject *);
     if(! arg.values) {
-        iter->val_func = (void *)cursor_key;
+        val_func = cursor_key;
     } else if(! arg.keys) {
-        iter->val_func = (void *)cursor_value;
+        val_func = cursor_value;
     } else {
-        iter->val_func = (void *)cursor_item;
+        val_func = cursor_item;
     }
-
-    iter->curs = self;
-    Py_INCREF(self);
-    iter->started = 0;
-    iter->op = op;
-    return (PyObject *) iter;
+    return make_iter(self, op, val_func, arg.batch);
 }
 
 static PyObject *
@@ -2135,11 +4363,13 @@ cursor_iter_from(CursorObject *self, PyObject *args)
     struct cursor_iter_from {
         MDB_val key;
         int reverse;
-    } arg = {{0, 0}, 0};
+        int batch;
+    } arg = {{0, 0}, 0, 1};
 
     static const struct argspec argspec[] = {
         {ARG_BUF, KEY_S, OFFSET(cursor_iter_from, key)},
-        {ARG_BOOL, REVERSE_S, OFFSET(cursor_iter_from, reverse)}
+        {ARG_BOOL, REVERSE_S, OFFSET(cursor_iter_from, reverse)},
+        {ARG_INT, BATCH_S, OFFSET(cursor_iter_from, batch)}
     };
 
     if(parse_args(self->valid, SPECSIZE(), argspec, args, NULL, &arg)) {
@@ -2150,52 +4380,359 @@ cursor_iter_from(CursorObject *self, PyObject *args)
     if((! arg.key.mv_size) && (! arg.reverse)) {
         rc = _cursor_get_c(self, MDB_FIRST);
     } else {
-        self->key = arg.key;
-        rc = _cursor_get_c(self, MDB_SET_RANGE);
+        self->key = arg.key;
+        rc = _cursor_get_c(self, MDB_SET_RANGE);
+    }
+
+    if(rc) {
+        return NULL;
+    }
+
+    enum MDB_cursor_op op = MDB_NEXT;
+    if(arg.reverse) {
+        op = MDB_PREV;
+        if(! self->positioned) {
+            if(_cursor_get_c(self, MDB_LAST)) {
+                return NULL;
+            }
+        }
+    }
+
+    DEBUG("positioned? %d", self->positioned)
+    return make_iter(self, op, cursor_item, arg.batch);
+}
+
+/**
+ * Cursor.iterrange(start=None, stop=None, include_stop=False, reverse=False,
+ *                  limit=None, keys=True, values=True)
+ *
+ * The stop key is compared using the database's comparison function, so no
+ * Python comparison is performed per element.
+ */
+static PyObject *
+cursor_iterrange(CursorObject *self, PyObject *args, PyObject *kwds)
+{
+    struct cursor_iterrange {
+        MDB_val start;
+        MDB_val stop;
+        int include_stop;
+        int reverse;
+        int limit;
+        int keys;
+        int values;
+    } arg = {{0, 0}, {0, 0}, 0, 0, -1, 1, 1};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, START_S, OFFSET(cursor_iterrange, start)},
+        {ARG_BUF, STOP_S, OFFSET(cursor_iterrange, stop)},
+        {ARG_BOOL, INCLUDE_STOP_S, OFFSET(cursor_iterrange, include_stop)},
+        {ARG_BOOL, REVERSE_S, OFFSET(cursor_iterrange, reverse)},
+        {ARG_INT, LIMIT_S, OFFSET(cursor_iterrange, limit)},
+        {ARG_BOOL, KEYS_S, OFFSET(cursor_iterrange, keys)},
+        {ARG_BOOL, VALUES_S, OFFSET(cursor_iterrange, values)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+
+    // In reverse, iteration starts from the stop key and ends at the start
+    // key, which is always included.
+    MDB_val *first = arg.reverse ? &arg.stop : &arg.start;
+    MDB_val *last = arg.reverse ? &arg.start : &arg.stop;
+    if(! first->mv_data) {
+        if(_cursor_get_c(self, arg.reverse ? MDB_LAST : MDB_FIRST)) {
+            return NULL;
+        }
+    } else {
+        // LMDB rejects empty keys, but every key is >= the empty string.
+        self->key = *first;
+        if(_cursor_get_c(self, first->mv_size ? MDB_SET_RANGE : MDB_FIRST)) {
+            return NULL;
+        }
+        if(arg.reverse) {
+            if(! self->positioned) {
+                if(_cursor_get_c(self, MDB_LAST)) {
+                    return NULL;
+                }
+            } else {
+                MDB_dbi dbi = mdb_cursor_dbi(self->curs);
+                int c = mdb_cmp(self->trans->txn, dbi, &self->key, first);
+                if(c > 0 || (c == 0 && ! arg.include_stop)) {
+                    if(_cursor_get_c(self, MDB_PREV)) {
+                        return NULL;
+                    }
+                }
+            }
+        }
+    }
+
+    PyObject *(*val_func)(CursorObject *);
+    if(! arg.values) {
+        val_func = cursor_key;
+    } else if(! arg.keys) {
+        val_func = cursor_value;
+    } else {
+        val_func = cursor_item;
+    }
+
+    IterObject *iter = (IterObject *) make_iter(self,
+        arg.reverse ? MDB_PREV : MDB_NEXT, val_func, 1);
+    if(! iter) {
+        return NULL;
+    }
+    iter->remaining = arg.limit;
+    if(last->mv_data) {
+        if(copy_val(&iter->stop, last)) {
+            Py_DECREF(iter);
+            return NULL;
+        }
+        iter->has_stop = 1;
+        iter->include_stop = arg.reverse || arg.include_stop;
+    }
+    return (PyObject *) iter;
+}
+
+/**
+ * Cursor.iterprefix(prefix, keys=True, values=True, reverse=False)
+ *
+ * Reverse iteration seeks to the first key following every key that starts
+ * with the prefix, then steps back.
+ */
+static PyObject *
+cursor_iterprefix(CursorObject *self, PyObject *args, PyObject *kwds)
+{
+    struct cursor_iterprefix {
+        MDB_val prefix;
+        int keys;
+        int values;
+        int reverse;
+    } arg = {{0, 0}, 1, 1, 0};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, PREFIX_S, OFFSET(cursor_iterprefix, prefix)},
+        {ARG_BOOL, KEYS_S, OFFSET(cursor_iterprefix, keys)},
+        {ARG_BOOL, VALUES_S, OFFSET(cursor_iterprefix, values)},
+        {ARG_BOOL, REVERSE_S, OFFSET(cursor_iterprefix, reverse)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! arg.prefix.mv_data) {
+        return type_error("prefix must be given.");
+    }
+
+    PyObject *(*val_func)(CursorObject *);
+    if(! arg.values) {
+        val_func = cursor_key;
+    } else if(! arg.keys) {
+        val_func = cursor_value;
+    } else {
+        val_func = cursor_item;
+    }
+
+    IterObject *iter = (IterObject *) make_iter(self,
+        arg.reverse ? MDB_PREV : MDB_NEXT, val_func, 1);
+    if(! iter) {
+        return NULL;
+    }
+    if(copy_val(&iter->prefix, &arg.prefix)) {
+        Py_DECREF(iter);
+        return NULL;
+    }
+    iter->has_prefix = 1;
+
+    int rc;
+    if(! arg.prefix.mv_size) {
+        rc = _cursor_get_c(self, arg.reverse ? MDB_LAST : MDB_FIRST);
+    } else if(! arg.reverse) {
+        self->key = arg.prefix;
+        rc = _cursor_get_c(self, MDB_SET_RANGE);
+    } else {
+        // The successor is the prefix with trailing 0xff bytes removed and
+        // the last remaining byte incremented. If every byte is 0xff, no key
+        // follows the prefixed keys.
+        MDB_val succ = iter->prefix;
+        unsigned char *p = succ.mv_data;
+        while(succ.mv_size && p[succ.mv_size - 1] == 0xff) {
+            succ.mv_size--;
+        }
+        if(! succ.mv_size) {
+            rc = _cursor_get_c(self, MDB_LAST);
+        } else {
+            // Increment a copy, since iter->prefix is still needed.
+            unsigned char *tmp = malloc(succ.mv_size);
+            if(! tmp) {
+                Py_DECREF(iter);
+                return PyErr_NoMemory();
+            }
+            memcpy(tmp, p, succ.mv_size);
+            tmp[succ.mv_size - 1]++;
+            self->key.mv_data = tmp;
+            self->key.mv_size = succ.mv_size;
+            rc = _cursor_get_c(self, MDB_SET_RANGE);
+            free(tmp);
+            if(! rc) {
+                rc = _cursor_get_c(self,
+                    self->positioned ? MDB_PREV : MDB_LAST);
+            }
+        }
+    }
+    if(rc) {
+        Py_DECREF(iter);
+        return NULL;
+    }
+    return (PyObject *) iter;
+}
+
+/**
+ * Cursor.fetch_columns(start=None, stop=None, max_items=None, max_bytes=None)
+ *   -> (keys, key_offsets, values, value_offsets, next_key)
+ *
+ * Copy a run of records into contiguous key and value blobs in a single pass
+ * with the GIL released, so a batch costs a handful of allocations rather than
+ * three per record. The blobs are returned as read-only Buffers that own them,
+ * rather than being copied again.
+ */
+static PyObject *
+cursor_fetch_columns(CursorObject *self, PyObject *args, PyObject *kwds)
+{
+    struct cursor_fetch_columns {
+        MDB_val start;
+        MDB_val stop;
+        size_t max_items;
+        size_t max_bytes;
+    } arg = {{0, 0}, {0, 0}, (size_t) -1, (size_t) -1};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, START_S, OFFSET(cursor_fetch_columns, start)},
+        {ARG_BUF, STOP_S, OFFSET(cursor_fetch_columns, stop)},
+        {ARG_SIZE, MAX_ITEMS_S, OFFSET(cursor_fetch_columns, max_items)},
+        {ARG_SIZE, MAX_BYTES_S, OFFSET(cursor_fetch_columns, max_bytes)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+
+    struct blob blobs[4] = {{0}};
+    struct blob *keys = blobs, *key_offs = blobs + 1;
+    struct blob *vals = blobs + 2, *val_offs = blobs + 3;
+    MDB_txn *txn = self->trans->txn;
+    MDB_dbi dbi = mdb_cursor_dbi(self->curs);
+    MDB_val key = arg.start;
+    MDB_val val;
+    size_t count = 0;
+    int more = 0;
+    int rc;
+    int i;
+
+    DROP_GIL(self->trans->env, GIL_SLOW)
+    uint64_t off = 0;
+    if(blob_append(key_offs, &off, sizeof off) ||
+       blob_append(val_offs, &off, sizeof off)) {
+        rc = ENOMEM;
+    } else {
+        rc = mdb_cursor_get(self->curs, &key, &val,
+                            key.mv_size ? MDB_SET_RANGE : MDB_FIRST);
+    }
+    while(! rc) {
+        if(arg.stop.mv_data && mdb_cmp(txn, dbi, &key, &arg.stop) >= 0) {
+            break;
+        }
+        // Always return at least one record, so callers make progress.
+        if(count && (count == arg.max_items ||
+                     (keys->size + vals->size + key.mv_size + val.mv_size)
+                        > arg.max_bytes)) {
+            more = 1;
+            break;
+        }
+        if(blob_append(keys, key.mv_data, key.mv_size) ||
+           blob_append(vals, val.mv_data, val.mv_size)) {
+            rc = ENOMEM;
+            break;
+        }
+        off = keys->size;
+        if(blob_append(key_offs, &off, sizeof off)) {
+            rc = ENOMEM;
+            break;
+        }
+        off = vals->size;
+        if(blob_append(val_offs, &off, sizeof off)) {
+            rc = ENOMEM;
+            break;
+        }
+        count++;
+        rc = mdb_cursor_get(self->curs, &key, &val, MDB_NEXT);
+    }
+    LOCK_GIL
+
+    PyObject *ret = NULL;
+    self->positioned = rc == 0;
+    self->val_stale = 0;
+    if(rc) {
+        self->key.mv_size = 0;
+        self->val.mv_size = 0;
+        if(rc != MDB_NOTFOUND) {
+            err_set("mdb_cursor_get", rc);
+            goto out;
+        }
+    } else {
+        self->key = key;
+        self->val = val;
     }
 
-    if(rc) {
-        return NULL;
+    PyObject *next_key = Py_None;
+    if(more) {
+        next_key = string_from_val(self->trans->env, &key);
+    } else {
+        Py_INCREF(next_key);
     }
-
-    enum MDB_cursor_op op = MDB_NEXT;
-    if(arg.reverse) {
-        op = MDB_PREV;
-        if(! self->positioned) {
-            if(_cursor_get_c(self, MDB_LAST)) {
-                return NULL;
-            }
+    if(! next_key || ! ((ret = PyTuple_New(5)))) {
+        Py_XDECREF(next_key);
+        goto out;
+    }
+    // Columns are moved into the result rather than copied again.
+    PyTuple_SET_ITEM(ret, 4, next_key);
+    for(i = 0; i < 4; i++) {
+        PyObject *buf = make_owned_buf(blobs + i);
+        if(! buf) {
+            Py_CLEAR(ret);
+            goto out;
         }
+        PyTuple_SET_ITEM(ret, i, buf);
     }
 
-    DEBUG("positioned? %d", self->positioned)
-    IterObject *iter = PyObject_New(IterObject, &PyIterator_Type);
-    if(iter) {
-        iter->val_func = (void *)cursor_item;
-        iter->curs = self;
-        Py_INCREF(self);
-        iter->started = 0;
-        iter->op = op;
+out:
+    for(i = 0; i < 4; i++) {
+        free(blobs[i].data);
     }
-    return (PyObject *) iter;
+    return ret;
 }
 
 static struct PyMethodDef cursor_methods[] = {
     {"count", (PyCFunction)cursor_count, METH_NOARGS},
     {"delete", (PyCFunction)cursor_delete, METH_NOARGS},
+    {"fetch_columns", (PyCFunction)cursor_fetch_columns,
+        METH_VARARGS|METH_KEYWORDS},
     {"first", (PyCFunction)cursor_first, METH_NOARGS},
-    {"get", (PyCFunction)cursor_get, METH_VARARGS|METH_KEYWORDS},
+    {"get", (PyCFunction)cursor_get, METH_FAST},
     {"item", (PyCFunction)cursor_item, METH_NOARGS},
     {"iternext", (PyCFunction)cursor_iternext, METH_VARARGS|METH_KEYWORDS},
     {"iterprev", (PyCFunction)cursor_iterprev, METH_VARARGS|METH_KEYWORDS},
+    {"iterprefix", (PyCFunction)cursor_iterprefix, METH_VARARGS|METH_KEYWORDS},
+    {"iterrange", (PyCFunction)cursor_iterrange, METH_VARARGS|METH_KEYWORDS},
     {"key", (PyCFunction)cursor_key, METH_NOARGS},
     {"last", (PyCFunction)cursor_last, METH_NOARGS},
     {"next", (PyCFunction)cursor_next, METH_NOARGS},
     {"prev", (PyCFunction)cursor_prev, METH_NOARGS},
-    {"put", (PyCFunction)cursor_put, METH_VARARGS|METH_KEYWORDS},
+    {"put", (PyCFunction)cursor_put, METH_FAST},
     {"set_key", (PyCFunction)cursor_set_key, METH_O},
     {"set_range", (PyCFunction)cursor_set_range, METH_O},
     {"value", (PyCFunction)cursor_value, METH_NOARGS},
+    {"value_into", (PyCFunction)cursor_value_into, METH_FAST},
+    {"value_range", (PyCFunction)cursor_value_range, METH_FAST},
     {"_iter_from", (PyCFunction)cursor_iter_from, METH_VARARGS},
     {NULL, NULL}
 };
@@ -2222,6 +4759,9 @@ iter_dealloc(IterObject *self)
 {
     DEBUG("destroying iterator")
     Py_CLEAR(self->curs);
+    free(self->batch);
+    free(self->stop.mv_data);
+    free(self->prefix.mv_data);
     PyObject_Del(self);
 }
 
@@ -2233,26 +4773,139 @@ iter_iter(IterObject *self)
     return (PyObject *)self;
 }
 
+/**
+ * Return 1 if the cursor's current key is within the iterator's limit and stop
+ * key, otherwise mark the iterator done and return 0.
+ */
+static int
+iter_in_bounds(IterObject *self)
+{
+    if(self->remaining == 0) {
+        self->done = 1;
+    } else if(self->has_prefix) {
+        MDB_val *key = &self->curs->key;
+        self->done = key->mv_size < self->prefix.mv_size ||
+            memcmp(key->mv_data, self->prefix.mv_data, self->prefix.mv_size);
+    } else if(self->has_stop) {
+        CursorObject *curs = self->curs;
+        int c = mdb_cmp(curs->trans->txn, mdb_cursor_dbi(curs->curs),
+                        &curs->key, &self->stop);
+        if(self->op == MDB_PREV) {
+            c = -c;
+        }
+        self->done = c > 0 || (c == 0 && ! self->include_stop);
+    }
+    if(self->done) {
+        return 0;
+    }
+    if(self->remaining > 0) {
+        self->remaining--;
+    }
+    return 1;
+}
+
+/**
+ * Refill the iterator's batch, starting with the cursor's current element if
+ * iteration has not started. The MDB cursor is left on the last element
+ * fetched, ahead of the element most recently returned. Returns -1 on error.
+ */
+static int
+iter_fill(IterObject *self)
+{
+    CursorObject *curs = self->curs;
+    MDB_val *batch = self->batch;
+    int len = 0;
+    int rc = 0;
+
+    if(! self->started) {
+        batch[0] = curs->key;
+        batch[1] = curs->val;
+        if(curs->val_stale) {
+            batch[1].mv_data = NULL;
+        }
+        len++;
+        self->started = 1;
+    }
+
+    DROP_GIL(curs->trans->env, GIL_SLOW)
+    while(len < self->batch_size) {
+        // Values left unresolved are marked by a NULL pointer, which LMDB
+        // never returns.
+        MDB_val *val = batch + (2 * len) + 1;
+        val->mv_data = NULL;
+        val->mv_size = 0;
+        rc = mdb_cursor_get(curs->curs, batch + (2 * len),
+                            self->keys_only ? NULL : val, self->op);
+        if(rc) {
+            break;
+        }
+        len++;
+    }
+    LOCK_GIL
+
+    if(rc == MDB_NOTFOUND) {
+        self->batch_eof = 1;
+    } else if(rc) {
+        err_set("mdb_cursor_get", rc);
+        return -1;
+    }
+    self->batch_pos = 0;
+    self->batch_len = len;
+    return 0;
+}
+
+static PyObject *
+iter_next_batch(IterObject *self)
+{
+    CursorObject *curs = self->curs;
+    if(self->batch_pos == self->batch_len) {
+        if((! self->batch_eof) && iter_fill(self)) {
+            return NULL;
+        }
+        if(self->batch_pos == self->batch_len) {
+            curs->positioned = 0;
+            curs->key.mv_size = 0;
+            curs->val.mv_size = 0;
+            curs->val_stale = 0;
+            return NULL;
+        }
+    }
+
+    MDB_val *pair = self->batch + (2 * self->batch_pos++);
+    curs->key = pair[0];
+    curs->val = pair[1];
+    curs->val_stale = ! pair[1].mv_data;
+    if(! iter_in_bounds(self)) {
+        return NULL;
+    }
+    return self->val_func(curs);
+}
+
 static PyObject *
 iter_next(IterObject *self)
 {
     if(! self->curs->valid) {
         return err_invalid();
     }
-    if(! self->curs->positioned) {
+    if(self->done || ! self->curs->positioned) {
         return NULL;
     }
+    if(self->batch_size) {
+        return iter_next_batch(self);
+    }
     if(self->started) {
-        if(_cursor_get_c(self->curs, self->op)) {
+        if(_cursor_move(self->curs, self->op, self->keys_only)) {
             return NULL;
         }
         if(! self->curs->positioned) {
             return NULL;
         }
     }
-    PyObject *val = self->val_func(self->curs);
     self->started = 1;
-    return val;
+    if(! iter_in_bounds(self)) {
+        return NULL;
+    }
+    return self->val_func(self->curs);
 }
 
 static struct PyMethodDef iter_methods[] = {
@@ -2276,20 +4929,42 @@ PyTypeObject PyIterator_Type = {
 // Transactions
 // ------------
 
+/**
+ * Release the transaction's MDB_txn by committing or aborting it. Read-only
+ * transactions are instead reset and returned to the environment's spare
+ * list, which for them is equivalent. Returns the MDB error code.
+ */
+static int
+trans_finish(TransObject *self, int commit)
+{
+    int rc = 0;
+    if(self->flags & TRANS_SPARE) {
+        env_txn_release(self->env, self->txn);
+    } else if(commit) {
+        UNLOCKED(rc, self->env,
+                 (self->flags & TRANS_RDONLY) ? GIL_CHEAP : GIL_SLOW,
+                 mdb_txn_commit(self->txn));
+    } else {
+        DROP_GIL(self->env, GIL_CHEAP)
+        mdb_txn_abort(self->txn);
+        LOCK_GIL
+    }
+    self->txn = NULL;
+    self->valid = 0;
+    return rc;
+}
+
 static int
 trans_clear(TransObject *self)
 {
     if(self->valid) {
         INVALIDATE(self)
-        if(self->txn) {
-            DEBUG("aborting")
-            DROP_GIL
-            mdb_txn_abort(self->txn);
-            LOCK_GIL
-            self->txn = NULL;
-        }
-        self->valid = 0;
     }
+    if(self->txn) {
+        DEBUG("aborting")
+        trans_finish(self, 0);
+    }
+    self->valid = 0;
     UNLINK_CHILD(self->env, self)
     Py_CLEAR(self->env);
     return 0;
@@ -2335,16 +5010,14 @@ trans_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 static PyObject *
 trans_abort(TransObject *self)
 {
-    if(! self->valid) {
+    if(! (self->valid || (self->flags & TRANS_RESET))) {
         return err_invalid();
     }
     DEBUG("aborting")
-    INVALIDATE(self)
-    DROP_GIL
-    mdb_txn_abort(self->txn);
-    LOCK_GIL
-    self->txn = NULL;
-    self->valid = 0;
+    if(self->valid) {
+        INVALIDATE(self)
+    }
+    trans_finish(self, 0);
     Py_RETURN_NONE;
 }
 
@@ -2356,16 +5029,55 @@ trans_commit(TransObject *self)
     }
     DEBUG("committing")
     INVALIDATE(self)
-    int rc;
-    UNLOCKED(rc, mdb_txn_commit(self->txn));
-    self->txn = NULL;
-    self->valid = 0;
+    int rc = trans_finish(self, 1);
     if(rc) {
         return err_set("mdb_txn_commit", rc);
     }
     Py_RETURN_NONE;
 }
 
+static PyObject *
+trans_id(TransObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    return PyLong_FromSize_t(mdb_txn_id(self->txn));
+}
+
+static PyObject *
+trans_reset(TransObject *self)
+{
+    if(! self->valid) {
+        return err_invalid();
+    }
+    if(! (self->flags & TRANS_RDONLY)) {
+        return type_error("Only read-only transactions may be reset.");
+    }
+    DEBUG("resetting")
+    INVALIDATE(self)
+    mdb_txn_reset(self->txn);
+    self->flags |= TRANS_RESET;
+    self->valid = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+trans_renew(TransObject *self)
+{
+    if(! self->txn) {
+        return err_invalid();
+    }
+    int rc;
+    UNLOCKED(rc, self->env, GIL_CHEAP, mdb_txn_renew(self->txn));
+    if(rc) {
+        return err_set("mdb_txn_renew", rc);
+    }
+    self->flags &= ~TRANS_RESET;
+    self->valid = 1;
+    Py_RETURN_NONE;
+}
+
 
 static PyObject *
 trans_cursor(TransObject *self, PyObject *args, PyObject *kwds)
@@ -2389,10 +5101,11 @@ trans_cursor(TransObject *self, PyObject *args, PyObject *kwds)
 
 
 static PyObject *
-trans_delete(TransObject *self, PyObject *args, PyObject *kwds)
+trans_delete(TransObject *self, FAST_ARGS_DECL)
 {
+    trans_end_reserve(self);
     return generic_delete(self->valid, self->txn, self->env->main_db,
-                          args, kwds);
+                          FAST_ARGS);
 }
 
 
@@ -2416,8 +5129,10 @@ trans_drop(TransObject *self, PyObject *args, PyObject *kwds)
         return type_error("'db' argument required.");
     }
 
+    trans_end_reserve(self);
     int rc;
-    UNLOCKED(rc, mdb_drop(self->txn, arg.db->dbi, arg.delete));
+    UNLOCKED(rc, self->env, GIL_SLOW,
+             mdb_drop(self->txn, arg.db->dbi, arg.delete));
     if(rc) {
         return err_set("mdb_drop", rc);
     }
@@ -2425,17 +5140,257 @@ trans_drop(TransObject *self, PyObject *args, PyObject *kwds)
 }
 
 static PyObject *
-trans_get(TransObject *self, PyObject *args, PyObject *kwds)
+trans_get(TransObject *self, FAST_ARGS_DECL)
+{
+    return generic_get(self->valid, self->txn, self->env->main_db, self,
+                       FAST_ARGS);
+}
+
+/**
+ * Transaction.get_into(key, buffer, offset=0, db=None) -> int
+ */
+static PyObject *
+trans_get_into(TransObject *self, FAST_ARGS_DECL)
+{
+    struct trans_get_into {
+        MDB_val key;
+        PyObject *buffer;
+        size_t offset;
+        DbObject *db;
+    } arg = {{0, 0}, NULL, 0, self->env->main_db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(trans_get_into, key)},
+        {ARG_OBJ, BUFFER_S, OFFSET(trans_get_into, buffer)},
+        {ARG_SIZE, OFFSET_S, OFFSET(trans_get_into, offset)},
+        {ARG_DB, DB_S, OFFSET(trans_get_into, db)}
+    };
+
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
+        return NULL;
+    }
+    if(! (arg.key.mv_data && arg.buffer)) {
+        return type_error("key and buffer must be given.");
+    }
+
+    MDB_val val;
+    int rc;
+    UNLOCKED(rc, self->env, GIL_CHEAP,
+             mdb_get(self->txn, arg.db->dbi, &arg.key, &val));
+    if(rc == MDB_NOTFOUND) {
+        return PyLong_FromLong(-1);
+    } else if(rc) {
+        return err_set("mdb_get", rc);
+    }
+    return val_into_buffer(self->env, &val, arg.buffer, arg.offset);
+}
+
+/**
+ * Transaction.get_range(key, offset=0, length=None, default=None, db=None)
+ *
+ * Like get(), but return only part of the value. Since large values live on
+ * overflow pages, pages outside the range are never touched.
+ */
+static PyObject *
+trans_get_range(TransObject *self, FAST_ARGS_DECL)
+{
+    struct trans_get_range {
+        MDB_val key;
+        size_t offset;
+        size_t length;
+        PyObject *default_;
+        DbObject *db;
+    } arg = {{0, 0}, 0, (size_t) -1, Py_None, self->env->main_db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(trans_get_range, key)},
+        {ARG_SIZE, OFFSET_S, OFFSET(trans_get_range, offset)},
+        {ARG_SIZE, LENGTH_S, OFFSET(trans_get_range, length)},
+        {ARG_OBJ, DEFAULT_S, OFFSET(trans_get_range, default_)},
+        {ARG_DB, DB_S, OFFSET(trans_get_range, db)}
+    };
+
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
+        return NULL;
+    }
+    if(! arg.key.mv_data) {
+        return type_error("key must be given.");
+    }
+
+    MDB_val val;
+    int rc;
+    UNLOCKED(rc, self->env, GIL_CHEAP,
+             mdb_get(self->txn, arg.db->dbi, &arg.key, &val));
+    if(rc == MDB_NOTFOUND) {
+        Py_INCREF(arg.default_);
+        return arg.default_;
+    } else if(rc) {
+        return err_set("mdb_get", rc);
+    }
+    slice_val(&val, arg.offset, arg.length);
+    if(self->buffers) {
+        return make_buf(self, &val);
+    }
+    return string_from_val(self->env, &val);
+}
+
+/**
+ * Transaction.open_value(key, db=None, sequential=False)
+ */
+static PyObject *
+trans_open_value(TransObject *self, PyObject *args, PyObject *kwds)
+{
+    struct trans_open_value {
+        MDB_val key;
+        DbObject *db;
+        int sequential;
+    } arg = {{0, 0}, self->env->main_db, 0};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(trans_open_value, key)},
+        {ARG_DB, DB_S, OFFSET(trans_open_value, db)},
+        {ARG_BOOL, SEQUENTIAL_S, OFFSET(trans_open_value, sequential)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! arg.key.mv_data) {
+        return type_error("key must be given.");
+    }
+
+    MDB_val val;
+    int rc;
+    UNLOCKED(rc, self->env, GIL_CHEAP,
+             mdb_get(self->txn, arg.db->dbi, &arg.key, &val));
+    if(rc == MDB_NOTFOUND) {
+        Py_RETURN_NONE;
+    } else if(rc) {
+        return err_set("mdb_get", rc);
+    }
+    return make_reader(self, &val, arg.sequential);
+}
+
+/**
+ * Transaction.value_size(key, db=None) -> int
+ */
+static PyObject *
+trans_value_size(TransObject *self, FAST_ARGS_DECL)
+{
+    struct trans_value_size {
+        MDB_val key;
+        DbObject *db;
+    } arg = {{0, 0}, self->env->main_db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(trans_value_size, key)},
+        {ARG_DB, DB_S, OFFSET(trans_value_size, db)}
+    };
+
+    if(PARSE_FAST_ARGS(self->valid, &arg)) {
+        return NULL;
+    }
+    if(! arg.key.mv_data) {
+        return type_error("key must be given.");
+    }
+
+    MDB_val val;
+    int rc;
+    UNLOCKED(rc, self->env, GIL_CHEAP,
+             mdb_get(self->txn, arg.db->dbi, &arg.key, &val));
+    if(rc == MDB_NOTFOUND) {
+        return PyLong_FromLong(-1);
+    } else if(rc) {
+        return err_set("mdb_get", rc);
+    }
+    return PyLong_FromSize_t(val.mv_size);
+}
+
+/**
+ * Transaction.reserve(key, size, db=None) -> Buffer
+ *
+ * Store an uninitialized value of `size` bytes using MDB_RESERVE, returning a
+ * writable buffer pointing at it in the dirty page, so it can be filled
+ * without first being built as a Python object.
+ */
+static PyObject *
+trans_reserve(TransObject *self, PyObject *args, PyObject *kwds)
+{
+    struct trans_reserve {
+        MDB_val key;
+        size_t size;
+        DbObject *db;
+    } arg = {{0, 0}, (size_t) -1, self->env->main_db};
+
+    static const struct argspec argspec[] = {
+        {ARG_BUF, KEY_S, OFFSET(trans_reserve, key)},
+        {ARG_SIZE, SIZE_S, OFFSET(trans_reserve, size)},
+        {ARG_DB, DB_S, OFFSET(trans_reserve, db)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! arg.key.mv_data || arg.size == (size_t) -1) {
+        return type_error("key and size must be given.");
+    }
+
+    trans_end_reserve(self);
+    MDB_val val = {arg.size, NULL};
+    int rc;
+    UNLOCKED(rc, self->env, LARGE_COST(arg.size),
+             mdb_put(self->txn, arg.db->dbi, &arg.key, &val, MDB_RESERVE));
+    if(rc) {
+        return err_set("mdb_put", rc);
+    }
+
+    BufObject *buf = (BufObject *) make_buf(self, &val);
+    if(buf) {
+        buf->writable = 1;
+        self->reserved = buf;
+    }
+    return (PyObject *) buf;
+}
+
+static PyObject *
+trans_getmany(TransObject *self, PyObject *args, PyObject *kwds)
 {
-    return generic_get(self->valid, self->txn, self->env->main_db,
-                       self->buffers, &self->key_buf, args, kwds);
+    if(! self->valid) {
+        return err_invalid();
+    }
+
+    struct trans_getmany {
+        PyObject *keys;
+        PyObject *default_;
+        DbObject *db;
+        int as_dict;
+        int sort;
+    } arg = {NULL, Py_None, self->env->main_db, 0, 0};
+
+    static const struct argspec argspec[] = {
+        {ARG_OBJ, KEYS_S, OFFSET(trans_getmany, keys)},
+        {ARG_OBJ, DEFAULT_S, OFFSET(trans_getmany, default_)},
+        {ARG_DB, DB_S, OFFSET(trans_getmany, db)},
+        {ARG_BOOL, AS_DICT_S, OFFSET(trans_getmany, as_dict)},
+        {ARG_BOOL, SORT_S, OFFSET(trans_getmany, sort)}
+    };
+
+    if(parse_args(self->valid, SPECSIZE(), argspec, args, kwds, &arg)) {
+        return NULL;
+    }
+    if(! arg.keys) {
+        return type_error("keys must be given");
+    }
+    return multi_get(self->txn, arg.db, arg.keys, arg.default_,
+                     arg.as_dict, arg.sort);
 }
 
 static PyObject *
-trans_put(TransObject *self, PyObject *args, PyObject *kwds)
+trans_put(TransObject *self, FAST_ARGS_DECL)
 {
+    trans_end_reserve(self);
     return generic_put(self->valid, self->txn, self->env->main_db,
-                       args, kwds);
+                       FAST_ARGS);
 }
 
 static PyObject *trans_enter(TransObject *self)
@@ -2449,10 +5404,10 @@ static PyObject *trans_enter(TransObject *self)
 
 static PyObject *trans_exit(TransObject *self, PyObject *args)
 {
-    if(! self->valid) {
+    if(! (self->valid || (self->flags & TRANS_RESET))) {
         return err_invalid();
     }
-    if(PyTuple_GET_ITEM(args, 0) == Py_None) {
+    if(self->valid && PyTuple_GET_ITEM(args, 0) == Py_None) {
         return trans_commit(self);
     } else {
         return trans_abort(self);
@@ -2466,10 +5421,19 @@ static struct PyMethodDef trans_methods[] = {
     {"abort", (PyCFunction)trans_abort, METH_NOARGS},
     {"commit", (PyCFunction)trans_commit, METH_NOARGS},
     {"cursor", (PyCFunction)trans_cursor, METH_VARARGS|METH_KEYWORDS},
-    {"delete", (PyCFunction)trans_delete, METH_VARARGS|METH_KEYWORDS},
+    {"delete", (PyCFunction)trans_delete, METH_FAST},
     {"drop", (PyCFunction)trans_drop, METH_VARARGS|METH_KEYWORDS},
-    {"get", (PyCFunction)trans_get, METH_VARARGS|METH_KEYWORDS},
-    {"put", (PyCFunction)trans_put, METH_VARARGS|METH_KEYWORDS},
+    {"get", (PyCFunction)trans_get, METH_FAST},
+    {"get_into", (PyCFunction)trans_get_into, METH_FAST},
+    {"get_range", (PyCFunction)trans_get_range, METH_FAST},
+    {"getmany", (PyCFunction)trans_getmany, METH_VARARGS|METH_KEYWORDS},
+    {"id", (PyCFunction)trans_id, METH_NOARGS},
+    {"open_value", (PyCFunction)trans_open_value, METH_VARARGS|METH_KEYWORDS},
+    {"put", (PyCFunction)trans_put, METH_FAST},
+    {"renew", (PyCFunction)trans_renew, METH_NOARGS},
+    {"reserve", (PyCFunction)trans_reserve, METH_VARARGS|METH_KEYWORDS},
+    {"reset", (PyCFunction)trans_reset, METH_NOARGS},
+    {"value_size", (PyCFunction)trans_value_size, METH_FAST},
     {NULL, NULL}
 };
 
@@ -2541,6 +5505,9 @@ MODINIT_NAME(void)
         &PyTransaction_Type,
         &PyIterator_Type,
         &PyDatabase_Type,
+        &PyBuf_Type,
+        &PyReader_Type,
+        &PyWriteBatch_Type,
         NULL
     };
     int i;
@@ -2,6 +2,10 @@
 import operator
 import os
 import shutil
+import struct
+import sys
+import threading
+import time
 import unittest
 
 import lmdb
@@ -94,7 +98,19 @@ class CrashTest(EnvMixin, unittest.TestCase):
 
 class LeakTest(EnvMixin, unittest.TestCase):
     # Various efforts to cause Python-level leaks.
-    pass
+
+    def testCursorItem(self):
+        self.env.put('key1', 'value1')
+        for buffers in False, True:
+            with self.env.begin(buffers=buffers) as txn:
+                curs = txn.cursor()
+                for key, value in curs.iternext():
+                    eq(2, sys.getrefcount(key))
+                    eq(2, sys.getrefcount(value))
+                curs.first()
+                key, value = curs.item()
+                eq(2, sys.getrefcount(key))
+                eq(2, sys.getrefcount(value))
 
 
 
@@ -229,6 +245,829 @@ class IteratorTest(EnvMixin, unittest.TestCase):
 
 
 
+class GetManyTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.txn = self.env.begin(write=True)
+        self.txn.put('a', '1')
+        self.txn.put('b', '')
+
+    def testList(self):
+        eq([], self.txn.getmany([]))
+        eq(['1', None, ''], self.txn.getmany(['a', 'x', 'b']))
+        eq(['1', 0], self.txn.getmany(iter(['a', 'x']), default=0))
+
+    def testDict(self):
+        eq({'a': '1', 'b': ''},
+           self.txn.getmany(['a', 'x', 'b'], as_dict=True))
+
+    def testBadKey(self):
+        assertCrash(lambda: self.txn.getmany(['a', 1]))
+
+    def testSorted(self):
+        keys = ['%05d' % i for i in xrange(0, 20000, 2)]
+        for key in keys:
+            self.txn.put(key, key, append=True)
+        want = ['%05d' % i for i in xrange(19999, -1, -3)] + ['a', 'x', 'a']
+        eq(self.txn.getmany(want), self.txn.getmany(want, sort=True))
+        eq(self.txn.getmany(want, as_dict=True),
+           self.txn.getmany(want, as_dict=True, sort=True))
+
+
+class SpareTxnTest(EnvMixin, unittest.TestCase):
+    def testReuse(self):
+        self.env.put('a', 'b')
+        for i in xrange(3):
+            with self.env.begin() as txn:
+                eq('b', txn.get('a'))
+        counters = self.env.counters()
+        eq(1, counters['spare_txns'])
+        le(2, counters['spare_txn_hits'])
+
+    def testResetRenew(self):
+        txn = self.env.begin()
+        curs = txn.cursor()
+        txn.reset()
+        assertCrash(lambda: txn.get('a'))
+        assertCrash(lambda: curs.first())
+        self.env.put('a', 'b')
+        txn.renew()
+        eq('b', txn.get('a'))
+        assertCrash(txn.renew)
+        txn.abort()
+
+    def testResetWrite(self):
+        txn = self.env.begin(write=True)
+        assertCrash(txn.reset)
+        txn.abort()
+
+
+class SnapshotTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        rmenv()
+        self.env = openenv(max_staleness=0)
+
+    def testSameTxnid(self):
+        self.env.put('a', 'b')
+        eq('b', self.env.get('a'))
+        eq({'a': 'b'}, self.env.gets(['a']))
+        eq(1, self.env.counters()['snapshot_hits'])
+
+    def testRefreshAfterCommit(self):
+        eq(None, self.env.get('a'))
+        self.env.put('a', 'b')
+        eq('b', self.env.get('a'))
+        eq(2, self.env.counters()['snapshot_misses'])
+
+
+class GilPolicyTest(EnvMixin, unittest.TestCase):
+    def testAuto(self):
+        self.env.put('a', 'b')
+        before = self.env.counters()
+        eq('b', self.env.get('a'))
+        after = self.env.counters()
+        eq(before['gil_released'], after['gil_released'])
+        lt(before['gil_kept'], after['gil_kept'])
+
+        self.env.put('big', 'x' * 100000)
+        eq(100000, len(self.env.get('big')))
+        lt(after['gil_released'], self.env.counters()['gil_released'])
+
+    def testNever(self):
+        self.env.close()
+        self.env = openenv(gil_policy='never')
+        self.env.put('a', 'b')
+        self.env.sync()
+        eq(0, self.env.counters()['gil_released'])
+
+    def testInvalid(self):
+        self.assertRaises(TypeError, lambda: openenv(gil_policy='sometimes'))
+
+
+class IterBatchTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        with self.env.begin(write=True) as txn:
+            for i in xrange(100):
+                txn.put('%03d' % i, str(i))
+
+    def testBatches(self):
+        with self.env.begin() as txn:
+            items = list(txn.cursor().iternext())
+            for batch in 2, 7, 100, 1000:
+                eq(items, list(txn.cursor().iternext(batch=batch)))
+                eq(items[::-1], list(txn.cursor().iterprev(batch=batch)))
+
+    def testCursorAhead(self):
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            it = curs.iternext(batch=10)
+            eq(('000', '0'), next(it))
+            eq('000', curs.key())
+            eq(('001', '1'), next(it))
+            eq('001', curs.key())
+
+
+class IterRangeTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        with self.env.begin(write=True) as txn:
+            for i in xrange(0, 20, 2):
+                txn.put('%02d' % i, str(i))
+
+    def keys(self, *args, **kwargs):
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            return list(curs.iterrange(values=False, *args, **kwargs))
+
+    def testForward(self):
+        eq(['04', '06'], self.keys('04', '08'))
+        eq(['04', '06', '08'], self.keys('03', '08', include_stop=True))
+        eq(['16', '18'], self.keys('15'))
+        eq(['00', '02'], self.keys(stop='03'))
+        eq([], self.keys('05', '05'))
+
+    def testReverse(self):
+        eq(['06', '04'], self.keys('04', '08', reverse=True))
+        eq(['08', '06', '04'], self.keys('03', '08', True, True))
+        eq(['18', '16'], self.keys('15', reverse=True))
+        eq(['02', '00'], self.keys(stop='03', reverse=True))
+
+    def testLimit(self):
+        eq(['04', '06'], self.keys('04', limit=2))
+        eq(['18'], self.keys(reverse=True, limit=1))
+        eq([], self.keys(limit=0))
+
+
+class IterPrefixTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        with self.env.begin(write=True) as txn:
+            for key in 'a', 'ab', 'ab\xff', 'ab\xffc', 'ac', '\xff\xff':
+                txn.put(key, '')
+
+    def keys(self, prefix, reverse=False):
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            return list(curs.iterprefix(prefix, values=False, reverse=reverse))
+
+    def testForward(self):
+        eq(['ab', 'ab\xff', 'ab\xffc'], self.keys('ab'))
+        eq(['ac'], self.keys('ac'))
+        eq([], self.keys('b'))
+        eq(6, len(self.keys('')))
+
+    def testReverse(self):
+        eq(['ab\xffc', 'ab\xff', 'ab'], self.keys('ab', True))
+        eq(['ab\xffc', 'ab\xff'], self.keys('ab\xff', True))
+        eq(['\xff\xff'], self.keys('\xff', True))
+        eq([], self.keys('aa', True))
+
+
+class FetchColumnsTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        with self.env.begin(write=True) as txn:
+            for i in xrange(10):
+                txn.put('%02d' % i, 'v' * i)
+
+    def fetch(self, *args, **kwargs):
+        with self.env.begin() as txn:
+            ret = txn.cursor().fetch_columns(*args, **kwargs)
+        keys, key_offsets, values, value_offsets, next_key = ret
+        key_offsets = struct.unpack('=%dQ' % (len(key_offsets) // 8),
+                                    bytes(key_offsets))
+        value_offsets = struct.unpack('=%dQ' % (len(value_offsets) // 8),
+                                      bytes(value_offsets))
+        items = [(bytes(keys[key_offsets[i]:key_offsets[i + 1]]),
+                  bytes(values[value_offsets[i]:value_offsets[i + 1]]))
+                 for i in xrange(len(key_offsets) - 1)]
+        return items, next_key
+
+    def testAll(self):
+        items, next_key = self.fetch()
+        eq([('%02d' % i, 'v' * i) for i in xrange(10)], items)
+        eq(None, next_key)
+
+    def testStop(self):
+        items, next_key = self.fetch('02', '05')
+        eq(['02', '03', '04'], [k for k, v in items])
+        eq(None, next_key)
+
+    def testLimits(self):
+        items, next_key = self.fetch(max_items=3)
+        eq(3, len(items))
+        eq('03', next_key)
+        items, next_key = self.fetch('05', max_bytes=1)
+        eq([('05', 'vvvvv')], items)
+        eq('06', next_key)
+
+    def testEmpty(self):
+        db = self.env.open_db('empty')
+        with self.env.begin() as txn:
+            ret = txn.cursor(db=db).fetch_columns()
+        keys, key_offsets, values, value_offsets, next_key = ret
+        eq('', bytes(keys))
+        eq(8, len(key_offsets))
+        eq('', bytes(values))
+        eq(None, next_key)
+
+
+class BufferTest(EnvMixin, unittest.TestCase):
+    def testDistinct(self):
+        txn = self.env.begin(write=True, buffers=True)
+        txn.put('a', 'aa')
+        txn.put('b', 'bb')
+        a = txn.get('a')
+        b = txn.get('b')
+        eq('aa', bytes(a))
+        eq('bb', bytes(b))
+        eq(2, len(a))
+        eq('a', bytes(a[:1]))
+        txn.abort()
+
+    def testInvalidated(self):
+        txn = self.env.begin(write=True, buffers=True)
+        txn.put('a', 'aa')
+        curs = txn.cursor()
+        curs.first()
+        key, value = curs.item()
+        txn.commit()
+        eq(0, len(key))
+        eq(0, len(value))
+        self.assertRaises(lmdb.Error, lambda: bytes(value))
+
+
+class GetIntoTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.put('a', '1234')
+
+    def testGetInto(self):
+        buf = bytearray(6)
+        with self.env.begin() as txn:
+            eq(4, txn.get_into('a', buf))
+            eq(4, txn.get_into('a', buf, 4))
+            eq(-1, txn.get_into('missing', buf))
+        eq('123412', bytes(buf))
+
+    def testValueInto(self):
+        buf = bytearray(2)
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            eq(-1, curs.value_into(buf))
+            curs.first()
+            eq(4, curs.value_into(buf))
+        eq('12', bytes(buf))
+
+
+class ReserveTest(EnvMixin, unittest.TestCase):
+    def testReserve(self):
+        with self.env.begin(write=True) as txn:
+            buf = txn.reserve('a', 4)
+            eq(4, len(buf))
+            buf[0:4] = 'abcd'
+        eq('abcd', self.env.get('a'))
+
+    def testInvalidatedByWrite(self):
+        with self.env.begin(write=True) as txn:
+            buf = txn.reserve('a', 4)
+            buf[0:4] = 'abcd'
+            txn.put('b', 'b')
+            eq(0, len(buf))
+
+    def testInvalidatedByOpenDb(self):
+        # Creating enough databases splits the leaf holding the value.
+        self.env.close()
+        self.env = lmdb.open(DB_PATH, max_dbs=64)
+        with self.env.begin(write=True) as txn:
+            for i in xrange(40):
+                txn.put('k%02d' % i, 'x' * 50)
+            buf = txn.reserve('k99', 100)
+            for i in xrange(40):
+                self.env.open_db('k%02dz' % i, txn=txn)
+            eq(0, len(buf))
+
+    def testInvalidatedByChild(self):
+        with self.env.begin(write=True) as txn:
+            buf = txn.reserve('a', 4)
+            buf[0:4] = 'abcd'
+            child = self.env.begin(write=True, parent=txn)
+            eq(0, len(buf))
+            child.put('b', 'x')
+            child.commit()
+            eq('abcd', txn.get('a'))
+        eq('abcd', self.env.get('a'))
+
+
+class GetRangeTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.put('a', '0123456789')
+
+    def testGetRange(self):
+        with self.env.begin() as txn:
+            eq('234', txn.get_range('a', 2, 3))
+            eq('89', txn.get_range('a', 8))
+            eq('', txn.get_range('a', 20))
+            eq(None, txn.get_range('missing', 0, 1))
+
+    def testValueSize(self):
+        with self.env.begin() as txn:
+            eq(10, txn.value_size('a'))
+            eq(-1, txn.value_size('missing'))
+
+    def testValueRange(self):
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            curs.first()
+            eq('12', curs.value_range(1, 2))
+            eq('9', curs.value_range(9, 100))
+
+
+class KeysOnlyTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.big = 'x' * 20000
+        with self.env.begin(write=True) as txn:
+            for k in 'abcd':
+                txn.put(k, k + self.big)
+
+    def testIter(self):
+        with self.env.begin() as txn:
+            curs = txn.cursor()
+            eq(list('abcd'), list(curs.iternext(values=False)))
+            eq(list('dcba'), list(curs.iterprev(values=False)))
+
+    def testLazyValue(self):
+        for batch in 1, 3:
+            with self.env.begin() as txn:
+                curs = txn.cursor()
+                for key in curs.iternext(values=False, batch=batch):
+                    val = curs.value()
+                    eq(len(self.big) + 1, len(val))
+                    eq((key, val), curs.item())
+                    eq(key, curs.value_range(0, 1))
+
+    def testDupsort(self):
+        db = self.env.open_db('dups', dupsort=True)
+        with self.env.begin(write=True) as txn:
+            for v in '123':
+                txn.put('a', v, db=db)
+            txn.put('b', '1', db=db)
+            curs = txn.cursor(db=db)
+            eq(['a', 'a', 'a', 'b'], list(curs.iternext(values=False)))
+
+
+class OpenValueTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.put('a', '0123456789' * 1000)
+
+    def testRead(self):
+        with self.env.begin() as txn:
+            fp = txn.open_value('a', sequential=True)
+            eq(10000, len(fp))
+            eq('0123', fp.read(4))
+            eq(4, fp.tell())
+            eq('45', fp.read(2))
+            eq(9994, len(fp.read()))
+            eq('', fp.read(1))
+            eq(None, txn.open_value('missing'))
+
+    def testReadinto(self):
+        with self.env.begin() as txn:
+            fp = txn.open_value('a')
+            buf = bytearray(6)
+            eq(6, fp.readinto(buf))
+            eq('012345', bytes(buf))
+            fp.seek(-2, 2)
+            eq(2, fp.readinto(buf))
+            eq('89', bytes(buf[:2]))
+            eq(0, fp.readinto(buf))
+
+    def testSeek(self):
+        with self.env.begin() as txn:
+            fp = txn.open_value('a')
+            eq(5, fp.seek(5))
+            eq(7, fp.seek(2, 1))
+            eq('7', fp.read(1))
+            eq(10010, fp.seek(10, 2))
+            eq('', fp.read())
+            self.assertRaises(ValueError, fp.seek, -1)
+
+    def testInvalid(self):
+        txn = self.env.begin()
+        fp = txn.open_value('a')
+        assert not fp.closed
+        txn.abort()
+        assert fp.closed
+        self.assertRaises(Exception, fp.read)
+
+    def testHoldsTxn(self):
+        fp = self.env.begin().open_value('a')
+        eq('0123', fp.read(4))
+        fp.close()
+        assert fp.closed
+
+
+class WriteBatchTest(EnvMixin, unittest.TestCase):
+    def testWrite(self):
+        self.env.put('b', 'old')
+        batch = lmdb.WriteBatch()
+        batch.put('a', '1')
+        batch.put('b', '2', overwrite=False)
+        batch.delete('b')
+        batch.delete('missing')
+        eq(4, len(batch))
+        eq([True, False, True, False], self.env.write(batch))
+        with self.env.begin() as txn:
+            eq('1', txn.get('a'))
+            eq(None, txn.get('b'))
+
+    def testSort(self):
+        db = self.env.open_db('sub')
+        batch = lmdb.WriteBatch()
+        for k in 'dbca':
+            batch.put(k, k)
+            batch.put(k, k + k, db=db)
+        batch.delete('c')
+        batch.put('c', 'new')
+        eq([True] * 10, self.env.write(batch, sort=True))
+        with self.env.begin() as txn:
+            eq('new', txn.get('c'))
+            eq('cc', txn.get('c', db=db))
+            eq(list('abcd'), list(txn.cursor(db=db).iternext(values=False)))
+
+    def testSortReverseKey(self):
+        db = self.env.open_db('rev', reverse_key=True)
+        batch = lmdb.WriteBatch()
+        for k in ['ab', 'ba', 'ca', 'ac']:
+            batch.put(k, k, db=db)
+        batch.put('ab', 'new', db=db)
+        eq([True] * 5, self.env.write(batch, sort=True))
+        with self.env.begin() as txn:
+            eq('new', txn.get('ab', db=db))
+            eq(['ba', 'ca', 'ab', 'ac'],
+               list(txn.cursor(db=db).iternext(values=False)))
+
+    def testCopies(self):
+        key = bytearray(b'k')
+        batch = lmdb.WriteBatch()
+        batch.put(key, 'v')
+        key[0] = ord('x')
+        self.env.write(batch)
+        eq('v', self.env.get('k'))
+        batch.clear()
+        eq(0, len(batch))
+        eq([], self.env.write(batch))
+
+    def testOtherEnv(self):
+        env2 = openenv()
+        try:
+            db = env2.open_db('sub')
+            batch = lmdb.WriteBatch()
+            batch.put('a', '1', db=db)
+            self.assertRaises(TypeError, self.env.write, batch)
+        finally:
+            env2.close()
+
+    def testFailure(self):
+        batch = lmdb.WriteBatch()
+        batch.put('a', '1')
+        batch.put('', '2')
+        self.assertRaises(lmdb.Error, self.env.write, batch)
+        eq(None, self.env.get('a'))
+
+
+class GroupCommitTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.close()
+        self.env = openenv(group_commit=True)
+
+    def testWrite(self):
+        batch = lmdb.WriteBatch()
+        batch.put('a', '1')
+        eq([True], self.env.write(batch))
+        eq('1', self.env.get('a'))
+        counters = self.env.counters()
+        eq(1, counters['group_writes'])
+        eq(1, counters['group_commits'])
+
+    def testThreads(self):
+        errors = []
+        def writer(n):
+            for i in xrange(20):
+                batch = lmdb.WriteBatch()
+                batch.put('%d-%d' % (n, i), 'x')
+                if i % 5 == 0:
+                    batch.put('', 'fail')
+                try:
+                    self.env.write(batch)
+                except lmdb.Error:
+                    errors.append((n, i))
+        threads = [threading.Thread(target=writer, args=(n,))
+                   for n in xrange(8)]
+        # Hold the write lock so the first leader blocks in mdb_txn_begin()
+        # while the other writers queue up behind it.
+        txn = self.env.begin(write=True)
+        for t in threads:
+            t.start()
+        time.sleep(0.2)
+        txn.abort()
+        for t in threads:
+            t.join()
+
+        eq(32, len(errors))
+        with self.env.begin() as txn:
+            for n in xrange(8):
+                for i in xrange(20):
+                    expect = None if (n, i) in errors else 'x'
+                    eq(expect, txn.get('%d-%d' % (n, i)))
+        counters = self.env.counters()
+        eq(160, counters['group_writes'])
+        lt(counters['group_commits'], counters['group_writes'])
+
+    def testWritemap(self):
+        self.env.close()
+        self.env = openenv(group_commit=True, writemap=True)
+        errors = []
+        def writer(n):
+            for i in xrange(50):
+                batch = lmdb.WriteBatch()
+                batch.put('%d-%d' % (n, i), 'x')
+                try:
+                    self.env.write(batch)
+                except lmdb.Error:
+                    errors.append((n, i))
+        threads = [threading.Thread(target=writer, args=(n,))
+                   for n in xrange(16)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        eq([], errors)
+        eq(800, self.env.stat()['entries'])
+        eq(800, self.env.counters()['group_commits'])
+
+
+class PipelineTest(EnvMixin, unittest.TestCase):
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.close()
+        self.env = openenv(pipeline=True)
+
+    def testWritemap(self):
+        self.env.close()
+        self.assertRaises(lmdb.Error, lambda: openenv(pipeline=True,
+                                                     writemap=True))
+
+    def testPositionalArgs(self):
+        # New arguments come after every older one, in both bindings.
+        self.env.close()
+        rmenv()
+        self.env = lmdb.open(DB_PATH, 1048576, True, False, True, True,
+                             False, 0o600)
+        eq(0o600, os.stat(DB_PATH + '/data.mdb').st_mode & 0o777)
+        self.env.close()
+        rmenv()
+        # Through max_spare_iters, then max_staleness, gil_policy,
+        # group_commit and sync_interval.
+        self.env = lmdb.open(DB_PATH, 1048576, True, False, True, True,
+                             False, 0o600, True, False, 126, 10, 1, 32, 32,
+                             None, None, False, 60000)
+        self.env.put('a', 'b')
+        lt(self.env.durable_txnid(), self.env.info()['last_txnid'])
+
+    def testThreads(self):
+        def writer(n):
+            for i in xrange(20):
+                with self.env.begin(write=True) as txn:
+                    txn.put('%d-%d' % (n, i), 'x')
+                    txn.delete('%d-%d' % (n, i - 1))
+        threads = [threading.Thread(target=writer, args=(n,))
+                   for n in xrange(8)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        self.env.close()
+        self.env = openenv()
+        with self.env.begin() as txn:
+            eq(sorted('%d-19' % n for n in xrange(8)),
+               list(txn.cursor().iternext(values=False)))
+        eq(160, self.env.info()['last_txnid'])
+
+
+class AsyncSyncTest(EnvMixin, unittest.TestCase):
+    def testSyncCommit(self):
+        with self.env.begin(write=True) as txn:
+            txn.put('a', 'b')
+            txnid = txn.id()
+        eq(txnid, self.env.durable_txnid())
+        assert self.env.wait_durable(txnid, timeout=0)
+
+    def testInterval(self):
+        self.env.close()
+        self.env = openenv(sync_interval=20)
+        with self.env.begin(write=True) as txn:
+            txn.put('a', 'b')
+            txnid = txn.id()
+        assert self.env.wait_durable(timeout=5000)
+        le(txnid, self.env.durable_txnid())
+
+    def testBytes(self):
+        self.env.close()
+        self.env = openenv(sync_bytes=1)
+        txnid = self.env.durable_txnid()
+        assert not self.env.wait_durable(txnid + 1, timeout=10)
+        self.env.put('a', 'b')
+        assert self.env.wait_durable(txnid + 1, timeout=5000)
+
+    def testClose(self):
+        self.env.close()
+        self.env = openenv(sync_interval=3600000)
+        self.env.put('a', 'b')
+        txnid = self.env.info()['last_txnid']
+        lt(self.env.durable_txnid(), txnid)
+        assert not self.env.wait_durable(timeout=0)
+        self.env.close()
+        self.env = openenv()
+        eq(txnid, self.env.durable_txnid())
+
+
+class SpillTest(EnvMixin, unittest.TestCase):
+    def testBigTxn(self):
+        # One record per page, more pages than fit in the dirty list.
+        keys = ['%06d' % i for i in xrange(140000)]
+        with self.env.begin(write=True) as txn:
+            for k in keys:
+                txn.put(k, k * 350)
+            for k in keys[::1000]:
+                eq(k * 350, txn.get(k))
+                txn.put(k, k)
+        with self.env.begin() as txn:
+            for k in keys[::1000]:
+                eq(k, txn.get(k))
+            eq(keys[1] * 350, txn.get(keys[1]))
+            eq(len(keys), sum(1 for _ in txn.cursor().iternext(values=False)))
+
+
+class ReaderSlotTest(EnvMixin, unittest.TestCase):
+    # Reader slots are claimed without a mutex, so race threads through a
+    # small reader table with the GIL released around every begin().
+    SLOTS = 4
+
+    def setUp(self):
+        EnvMixin.setUp(self)
+        self.env.close()
+        rmenv()
+        self.env = openenv(max_readers=self.SLOTS, max_spare_txns=0,
+                           gil_policy='always')
+
+    def assertFull(self):
+        try:
+            self.env.begin()
+        except lmdb.Error as e:
+            assert 'READERS_FULL' in str(e), e
+        else:
+            self.fail('reader table should be full')
+
+    def testClaimRace(self):
+        # Each round every thread claims a slot at once. All must succeed,
+        # and only then may the table be full, so no two share a slot.
+        go = threading.Semaphore(0)
+        held = threading.Semaphore(0)
+        release = threading.Semaphore(0)
+        done = threading.Semaphore(0)
+        stop = []
+        errors = []
+        def reader():
+            while True:
+                go.acquire()
+                if stop:
+                    return
+                try:
+                    txn = self.env.begin()
+                except lmdb.Error as e:
+                    errors.append(e)
+                    txn = None
+                held.release()
+                release.acquire()
+                if txn:
+                    txn.abort()
+                done.release()
+        threads = [threading.Thread(target=reader)
+                   for i in xrange(self.SLOTS)]
+        for t in threads:
+            t.start()
+        try:
+            for i in xrange(200):
+                for t in threads:
+                    go.release()
+                for t in threads:
+                    held.acquire()
+                eq([], errors)
+                self.assertFull()
+                for t in threads:
+                    release.release()
+                for t in threads:
+                    done.acquire()
+        finally:
+            stop.append(True)
+            for t in threads:
+                release.release()
+                go.release()
+            for t in threads:
+                t.join()
+
+    def testChurn(self):
+        # More threads than slots; READERS_FULL is expected, but every slot
+        # must be free again afterwards.
+        errors = []
+        def reader():
+            for i in xrange(500):
+                try:
+                    self.env.begin().abort()
+                except lmdb.Error as e:
+                    if 'READERS_FULL' not in str(e):
+                        errors.append(e)
+        threads = [threading.Thread(target=reader)
+                   for i in xrange(self.SLOTS * 2)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        eq([], errors)
+        le(self.env.info()['num_readers'], self.SLOTS)
+        eq(0, self.env.reader_check())
+        txns = [self.env.begin() for i in xrange(self.SLOTS)]
+        self.assertFull()
+        for txn in txns:
+            txn.abort()
+
+
+class ReaderCheckTest(EnvMixin, unittest.TestCase):
+    def crashReader(self, **kwargs):
+        # Leave a read transaction behind in a process that no longer exists.
+        pid = os.fork()
+        if not pid:
+            env = openenv(**kwargs)
+            txn = env.begin()
+            os._exit(0)
+        os.waitpid(pid, 0)
+
+    def testReaderCheck(self):
+        txn = self.env.begin()
+        self.crashReader()
+        eq(1, self.env.reader_check())
+        eq(0, self.env.reader_check())
+        txn.abort()
+
+    def testReadersFull(self):
+        self.env.close()
+        rmenv()
+        self.env = openenv(max_readers=2)
+        self.crashReader(max_readers=2)
+        txn = self.env.begin()
+        self.assertRaises(lmdb.Error, self.env.begin)
+        eq(1, self.env.reader_check())
+        txn.abort()
+
+    def testReadersFullAuto(self):
+        self.env.close()
+        rmenv()
+        self.env = openenv(max_readers=2, auto_reader_check=True)
+        self.crashReader(max_readers=2)
+        txn = self.env.begin()
+        txn2 = self.env.begin()
+        eq(0, self.env.reader_check())
+        txn.abort()
+        txn2.abort()
+
+    def churn(self):
+        # Rewrite a record spanning several pages, returning the last page
+        # used, which grows while a stale reader keeps old pages pinned.
+        self.env.put('a', 'x' * 20000)
+        self.crashReader()
+        for i in xrange(20):
+            self.env.put('a', str(i % 10) * 20000)
+        return self.env.info()['last_pgno']
+
+    def testFreelistStarvation(self):
+        last_pgno = self.churn()
+        eq(1, self.env.reader_check())
+        self.env.close()
+        rmenv()
+        self.env = openenv(auto_reader_check=True)
+        lt(self.churn(), last_pgno)
+        eq(0, self.env.reader_check())
+
+
 class BigReverseTest(EnvMixin, unittest.TestCase):
     # Test for issue with MDB_LAST+MDB_PREV skipping chunks of database.
     def test_big_reverse(self):